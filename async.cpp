@@ -0,0 +1,675 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#include "async.h"
+#include "compress.h"
+#include "source.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#ifdef XDOC_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// 每次读取的块大小, 以及每个请求同时在途的块数.
+#define XDOC_ASYNC_CHUNK (256 * 1024)
+#define XDOC_ASYNC_DEPTH (4)
+#define XDOC_RING_ENTRIES (64)
+
+struct XAsyncLoader::Request : XStream {
+  std::string    path;
+  XDocument     *doc;
+  XAsyncCallback cb;
+  XParseOptions  opts;
+
+  int   fd;
+  char *buf;
+
+  // 以下字段仅由 I/O 线程访问.
+  size_t            issued;   // 已提交读取的字节数.
+  unsigned          inflight; // 在途的读取数.
+  std::vector<bool> chunks;   // 已读完的块.
+  size_t            prefix;   // 连续读完的块数.
+
+  // 以下字段由 mutex 保护.
+  std::mutex              mutex;
+  std::condition_variable cond;
+  size_t arrived;
+  bool   error;
+  bool   cancelled; // 解析已经结束, 不再提交新的读取.
+  bool   ioDone;    // 不会再有在途的读取.
+
+  Request() {
+    doc = nullptr;
+    fd = -1;
+    buf = nullptr;
+    issued = 0;
+    inflight = 0;
+    prefix = 0;
+    arrived = 0;
+    error = false;
+    cancelled = false;
+    ioDone = false;
+  }
+
+  bool wait(size_t have, size_t *now) override {
+    std::unique_lock<std::mutex> lk(mutex);
+    cond.wait(lk, [&] { return arrived > have || arrived == size || error; });
+    *now = arrived;
+    return error;
+  }
+
+  // 块 index 的 n 个字节已经读完.
+  void complete(size_t index, size_t len) {
+    chunks[index] = true;
+    while (prefix < chunks.size() && chunks[prefix])
+      prefix++;
+
+    std::lock_guard<std::mutex> lk(mutex);
+    arrived = prefix * XDOC_ASYNC_CHUNK;
+    if (arrived > size) arrived = size;
+    (void) len;
+    cond.notify_all();
+  }
+
+  void fail() {
+    std::lock_guard<std::mutex> lk(mutex);
+    error = true;
+    cond.notify_all();
+  }
+
+  // 读取是否已经结束, 结束时通知等待释放缓冲区的解析线程.
+  bool settle() {
+    std::lock_guard<std::mutex> lk(mutex);
+    if (inflight != 0)
+      return false;
+    if (!cancelled && !error && issued < size)
+      return false;
+    ioDone = true;
+    cond.notify_all();
+    return true;
+  }
+};
+
+#ifdef XDOC_HAVE_IO_URING
+
+// 直接通过系统调用使用 io_uring, 不依赖 liburing.
+struct XAsyncLoader::Ring {
+  // 一次在途的读取.
+  struct Read {
+    Request     *req;
+    size_t       index;
+    size_t       off;
+    size_t       len;
+    struct iovec iov;
+  };
+
+  int       fd;
+  unsigned  entries;
+  unsigned  pending;  // 已填写但尚未提交的 sqe 数.
+  unsigned  inflight; // 已提交但尚未完成的 sqe 数.
+
+  // 唤醒用的读取可能在 I/O 线程退出后才完成, 目标放在 Ring 中.
+  uint64_t     wakeBuf;
+  struct iovec wakeIov;
+
+  void     *sqPtr, *cqPtr;
+  size_t    sqSize, cqSize;
+  unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+
+  Ring() {
+    fd = -1;
+    sqPtr = cqPtr = MAP_FAILED;
+    sqes = (struct io_uring_sqe *) MAP_FAILED;
+    pending = inflight = 0;
+  }
+
+  ~Ring() {
+    if (sqes != MAP_FAILED)
+      munmap(sqes, entries * sizeof(struct io_uring_sqe));
+    if (cqPtr != MAP_FAILED && cqPtr != sqPtr)
+      munmap(cqPtr, cqSize);
+    if (sqPtr != MAP_FAILED)
+      munmap(sqPtr, sqSize);
+    if (fd >= 0)
+      close(fd);
+  }
+
+  bool setup(unsigned n) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    fd = (int) syscall(__NR_io_uring_setup, n, &p);
+    if (fd < 0)
+      return true;
+
+    entries = p.sq_entries;
+    sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      if (cqSize > sqSize) sqSize = cqSize;
+      cqSize = sqSize;
+    }
+
+    sqPtr = mmap(NULL, sqSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqPtr == MAP_FAILED)
+      return true;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      cqPtr = sqPtr;
+    } else {
+      cqPtr = mmap(NULL, cqSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (cqPtr == MAP_FAILED)
+        return true;
+    }
+
+    sqes = (struct io_uring_sqe *) mmap(
+        NULL, entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+      return true;
+
+    char *sq = (char *) sqPtr, *cq = (char *) cqPtr;
+    sqHead  = (unsigned *) (sq + p.sq_off.head);
+    sqTail  = (unsigned *) (sq + p.sq_off.tail);
+    sqMask  = (unsigned *) (sq + p.sq_off.ring_mask);
+    sqArray = (unsigned *) (sq + p.sq_off.array);
+    cqHead  = (unsigned *) (cq + p.cq_off.head);
+    cqTail  = (unsigned *) (cq + p.cq_off.tail);
+    cqMask  = (unsigned *) (cq + p.cq_off.ring_mask);
+    cqes    = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    return false;
+  }
+
+  // 完成队列的容量至少是提交队列的两倍, 在途数不超过 entries 即不会溢出.
+  bool full() {
+    return inflight + pending >= entries;
+  }
+
+  void readv(int fd, struct iovec *iov, uint64_t data, off_t off) {
+    unsigned tail = *sqTail;
+    unsigned i = tail & *sqMask;
+    struct io_uring_sqe *sqe = &sqes[i];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = (uint64_t) off;
+    sqe->addr = (uint64_t) (uintptr_t) iov;
+    sqe->len = 1;
+    sqe->user_data = data;
+
+    sqArray[i] = i;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    pending++;
+  }
+
+  // 提交所有待提交的 sqe, 并等待至少一个完成.
+  bool enter() {
+    while (true) {
+      int rc = (int) syscall(__NR_io_uring_enter, fd, pending, 1,
+                             IORING_ENTER_GETEVENTS, NULL, 0);
+      if (rc >= 0) {
+        inflight += (unsigned) rc;
+        pending -= (unsigned) rc;
+        return false;
+      }
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        return true;
+    }
+  }
+
+  // 撤回已填写但内核尚未取走的 sqe, 对其中每一个调用 handle.
+  template <typename F>
+  void unsubmit(F handle) {
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *sqTail;
+    for (unsigned i = head; i != tail; i++)
+      handle(sqes[sqArray[i & *sqMask]].user_data);
+    __atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+    pending = 0;
+  }
+
+  template <typename F>
+  void reap(F handle) {
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+      struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+      handle(cqe->user_data, cqe->res);
+      inflight--;
+      head++;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+  }
+};
+
+#else
+
+struct XAsyncLoader::Ring {};
+
+#endif
+
+XAsyncLoader::XAsyncLoader(unsigned threads) {
+  ring_ = nullptr;
+  doneFd_ = -1;
+  wakeFd_ = -1;
+  quit_ = false;
+  ioQuit_ = false;
+  ringBroken_ = false;
+
+#ifdef __linux__
+  doneFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE);
+#endif
+
+#ifdef XDOC_HAVE_IO_URING
+  // 内核不支持或被禁止使用 io_uring 时退化为 pread.
+  ring_ = new Ring();
+  wakeFd_ = eventfd(0, EFD_CLOEXEC);
+  if (wakeFd_ < 0 || ring_->setup(XDOC_RING_ENTRIES)) {
+    delete ring_;
+    ring_ = nullptr;
+    if (wakeFd_ >= 0) close(wakeFd_);
+    wakeFd_ = -1;
+  }
+#endif
+
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  if (threads == 0)
+    threads = 1;
+
+  for (unsigned i = 0; i < threads; i++)
+    workers_.push_back(std::thread(&XAsyncLoader::parseLoop, this));
+
+  if (ring_)
+    io_ = std::thread(&XAsyncLoader::ioLoop, this);
+  else
+    io_ = std::thread(&XAsyncLoader::ioLoopFallback, this);
+}
+
+XAsyncLoader::~XAsyncLoader() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    quit_ = true;
+  }
+  wake_.notify_all();
+  for (size_t i = 0; i < workers_.size(); i++)
+    workers_[i].join();
+
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    ioQuit_ = true;
+  }
+  wakeIo();
+  io_.join();
+
+#ifdef XDOC_HAVE_IO_URING
+  delete ring_;
+  if (wakeFd_ >= 0) close(wakeFd_);
+#endif
+  if (doneFd_ >= 0) close(doneFd_);
+}
+
+void XAsyncLoader::submit(const std::string& path, XDocument *doc,
+                          const XAsyncCallback& cb,
+                          const XParseOptions& opts) {
+  Request *req = new Request();
+  req->path = path;
+  req->doc = doc;
+  req->cb = cb;
+  req->opts = opts;
+
+  std::lock_guard<std::mutex> lk(mutex_);
+  queue_.push_back(req);
+  wake_.notify_one();
+}
+
+int XAsyncLoader::eventFd() const {
+  return doneFd_;
+}
+
+bool XAsyncLoader::poll(XDocument **doc, bool *ok) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (completed_.empty())
+    return false;
+  takeCompleted(doc, ok);
+  return true;
+}
+
+void XAsyncLoader::wait(XDocument **doc, bool *ok) {
+  // 在同一个临界区内取出结果, 多个线程同时等待时不会被别人抢走.
+  std::unique_lock<std::mutex> lk(mutex_);
+  done_.wait(lk, [this] { return !completed_.empty(); });
+  takeCompleted(doc, ok);
+}
+
+// 调用者需持有 mutex_, 且完成队列非空.
+void XAsyncLoader::takeCompleted(XDocument **doc, bool *ok) {
+  *doc = completed_.front().first;
+  *ok = completed_.front().second;
+  completed_.pop_front();
+
+  if (doneFd_ >= 0) {
+    uint64_t v;
+    ssize_t rc = read(doneFd_, &v, sizeof(v));
+    (void) rc;
+  }
+}
+
+bool XAsyncLoader::usingIoUring() const {
+  return ring_ != nullptr && !ringBroken_;
+}
+
+void XAsyncLoader::wakeIo() {
+  // io_uring 出错后 I/O 线程改为等待 ioWake_, 两种方式都通知一次.
+  if (wakeFd_ >= 0) {
+    uint64_t v = 1;
+    ssize_t rc = write(wakeFd_, &v, sizeof(v));
+    (void) rc;
+  }
+  ioWake_.notify_one();
+}
+
+void XAsyncLoader::parseLoop() {
+  buffer_t content;
+  buffer_init(&content);
+
+  while (true) {
+    Request *req;
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      wake_.wait(lk, [this] { return quit_ || !queue_.empty(); });
+      if (queue_.empty())
+        break;
+      req = queue_.front();
+      queue_.pop_front();
+    }
+
+    finish(req, process(req, &content));
+  }
+
+  buffer_free(&content);
+}
+
+static bool IsCompressed(int fd) {
+  char magic[4];
+  ssize_t rn = pread(fd, magic, sizeof(magic), 0);
+  return rn > 0 && XDetectCompression(magic, (size_t) rn) != xCompressNone;
+}
+
+bool XAsyncLoader::process(Request *req, buffer_t *content) {
+  // 只有长度已知的普通文件才能预先分配缓冲区并边读边解析,
+  // 其余情况(包括打开失败)交给同步加载处理, 以便得到一致的错误信息.
+  // 压缩的文件由同步加载在后台线程中解压.
+  struct stat st;
+  req->fd = open(req->path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (req->fd < 0 || fstat(req->fd, &st) != 0
+   || !S_ISREG(st.st_mode) || st.st_size <= 0
+   || IsCompressed(req->fd)) {
+    if (req->fd >= 0) close(req->fd);
+    return req->doc->loadFile(req->path, req->opts, content);
+  }
+
+  req->size = (size_t) st.st_size;
+  req->buf = (char *) malloc(req->size + BUFFER_PADDING);
+  if (req->buf == nullptr) {
+    close(req->fd);
+    req->doc->clear();
+    req->doc->setError(xErrMemAlloc, "no enough memory");
+    return false;
+  }
+  // 解析器与 SIMD 扫描依赖末尾的填充字节为 0, 与 buffer_terminate 相同.
+  memset(req->buf + req->size, 0, BUFFER_PADDING);
+  req->data = req->buf;
+  req->chunks.assign((req->size + XDOC_ASYNC_CHUNK - 1) / XDOC_ASYNC_CHUNK,
+                     false);
+
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    ioQueue_.push_back(req);
+  }
+  wakeIo();
+
+  bool ok = req->doc->load(req, req->opts, content);
+
+  // 解析结束(或出错)后不再需要剩余的内容, 但必须等在途的读取全部
+  // 完成才能释放缓冲区.
+  {
+    std::unique_lock<std::mutex> lk(req->mutex);
+    req->cancelled = true;
+  }
+  wakeIo();
+  {
+    std::unique_lock<std::mutex> lk(req->mutex);
+    req->cond.wait(lk, [req] { return req->ioDone; });
+  }
+
+  close(req->fd);
+  free(req->buf);
+  return ok;
+}
+
+void XAsyncLoader::finish(Request *req, bool ok) {
+  if (req->cb) {
+    req->cb(*req->doc, ok);
+  } else {
+    std::lock_guard<std::mutex> lk(mutex_);
+    completed_.push_back(std::make_pair(req->doc, ok));
+    if (doneFd_ >= 0) {
+      uint64_t v = 1;
+      ssize_t rc = write(doneFd_, &v, sizeof(v));
+      (void) rc;
+    }
+    done_.notify_all();
+  }
+  delete req;
+}
+
+void XAsyncLoader::ioLoop() {
+#ifdef XDOC_HAVE_IO_URING
+  Ring& ring = *ring_;
+  std::vector<Request *> active;
+  bool armed = false;
+
+  ring.wakeIov.iov_base = &ring.wakeBuf;
+  ring.wakeIov.iov_len = sizeof(ring.wakeBuf);
+
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      while (!ioQueue_.empty()) {
+        active.push_back(ioQueue_.front());
+        ioQueue_.pop_front();
+      }
+      if (ioQuit_ && active.empty())
+        break;
+    }
+
+    // 始终保持一个对 wakeFd_ 的读取在途, 新请求或取消到来时借此唤醒.
+    if (!armed) {
+      ring.readv(wakeFd_, &ring.wakeIov, 0, 0);
+      armed = true;
+    }
+
+    for (size_t i = 0; i < active.size(); i++) {
+      Request *req = active[i];
+      bool cancelled;
+      {
+        std::lock_guard<std::mutex> lk(req->mutex);
+        cancelled = req->cancelled;
+      }
+      while (!cancelled && !ring.full() && req->inflight < XDOC_ASYNC_DEPTH
+          && req->issued < req->size) {
+        Ring::Read *rd = new Ring::Read();
+        rd->req = req;
+        rd->index = req->issued / XDOC_ASYNC_CHUNK;
+        rd->off = req->issued;
+        rd->len = req->size - req->issued;
+        if (rd->len > XDOC_ASYNC_CHUNK) rd->len = XDOC_ASYNC_CHUNK;
+        rd->iov.iov_base = req->buf + rd->off;
+        rd->iov.iov_len = rd->len;
+        ring.readv(req->fd, &rd->iov, (uint64_t) (uintptr_t) rd, (off_t) rd->off);
+        req->issued += rd->len;
+        req->inflight++;
+      }
+    }
+
+    if (ring.enter()) {
+      // io_uring 出现无法恢复的错误, 让进行中的请求失败, 之后的请求
+      // 改用 pread 读取.
+      abandonRing(active);
+      ioLoopFallback();
+      return;
+    }
+
+    ring.reap([&](uint64_t data, int res) {
+      if (data == 0) {
+        armed = false;
+        return;
+      }
+
+      Ring::Read *rd = (Ring::Read *) (uintptr_t) data;
+      Request *req = rd->req;
+      if (res <= 0) {
+        req->issued = req->size;
+        req->fail();
+      } else if ((size_t) res < rd->len) {
+        // 读取不完整时继续读取剩余部分.
+        rd->off += (size_t) res;
+        rd->len -= (size_t) res;
+        rd->iov.iov_base = req->buf + rd->off;
+        rd->iov.iov_len = rd->len;
+        ring.readv(req->fd, &rd->iov, data, (off_t) rd->off);
+        return;
+      } else {
+        req->complete(rd->index, rd->len);
+      }
+      req->inflight--;
+      delete rd;
+    });
+
+    for (size_t i = 0; i < active.size();) {
+      if (active[i]->settle()) {
+        active[i] = active.back();
+        active.pop_back();
+      } else {
+        i++;
+      }
+    }
+  }
+#endif
+}
+
+void XAsyncLoader::abandonRing(std::vector<Request *>& active) {
+#ifdef XDOC_HAVE_IO_URING
+  Ring& ring = *ring_;
+  ringBroken_ = true;
+
+  auto drop = [](uint64_t data) {
+    if (data == 0)
+      return;
+    Ring::Read *rd = (Ring::Read *) (uintptr_t) data;
+    rd->req->inflight--;
+    delete rd;
+  };
+
+  // 内核尚未取走的读取不会再执行, 直接丢弃.
+  ring.unsubmit(drop);
+
+  // 已经提交的读取仍会写入请求的缓冲区, 必须等它们完成才能让解析线程
+  // 释放缓冲区. 完成队列位于共享内存中, 不需要系统调用即可收割.
+  for (size_t i = 0; i < active.size(); i++) {
+    Request *req = active[i];
+    req->issued = req->size;
+    req->fail();
+    while (req->inflight != 0) {
+      ring.reap([&](uint64_t data, int) { drop(data); });
+      if (req->inflight != 0)
+        usleep(1000);
+    }
+    req->settle();
+  }
+  active.clear();
+#else
+  (void) active;
+#endif
+}
+
+void XAsyncLoader::ioLoopFallback() {
+  std::vector<Request *> active;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      while (!ioQueue_.empty()) {
+        active.push_back(ioQueue_.front());
+        ioQueue_.pop_front();
+      }
+      if (active.empty()) {
+        if (ioQuit_)
+          break;
+        ioWake_.wait(lk);
+        continue;
+      }
+    }
+
+    // 轮流为每个请求读取一块, 使多个文件的解析都能尽早开始.
+    for (size_t i = 0; i < active.size();) {
+      Request *req = active[i];
+      bool cancelled;
+      {
+        std::lock_guard<std::mutex> lk(req->mutex);
+        cancelled = req->cancelled;
+      }
+
+      if (!cancelled && req->issued < req->size) {
+        size_t off = req->issued;
+        size_t len = req->size - off;
+        if (len > XDOC_ASYNC_CHUNK) len = XDOC_ASYNC_CHUNK;
+
+        size_t done = 0;
+        while (done < len) {
+          ssize_t rn = pread(req->fd, req->buf + off + done, len - done,
+                             (off_t) (off + done));
+          if (rn < 0 && errno == EINTR)
+            continue;
+          if (rn <= 0)
+            break;
+          done += (size_t) rn;
+        }
+
+        req->issued += len;
+        if (done < len) {
+          req->issued = req->size;
+          req->fail();
+        } else {
+          req->complete(off / XDOC_ASYNC_CHUNK, len);
+        }
+      }
+
+      if (req->settle()) {
+        active[i] = active.back();
+        active.pop_back();
+      } else {
+        i++;
+      }
+    }
+  }
+}
@@ -0,0 +1,89 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_ASYNC_H
+#define LIBXDOC_ASYNC_H
+
+#include "document.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+///@brief 异步加载完成时的回调, 在内部的解析线程上调用.
+typedef std::function<void(XDocument& doc, bool ok)> XAsyncCallback;
+
+///@brief 异步加载文件.
+/// 读取由一个 I/O 线程通过 io_uring 分块提交(不可用时退化为由该线程
+/// 使用 pread 读取), 首批数据块到达后解析线程即开始解析, 与后续的
+/// 读取重叠进行, 非 UTF-8 的文件同样边读取边转码. 压缩的文件边解压边
+/// 解析, 但解压后的长度事先未知, 不是 UTF-8 时需要全部解压之后才开始
+/// 转码. 调用者的线程不会因为磁盘 I/O 而阻塞, 完成通知可以
+/// 通过回调获得, 也可以把 eventFd() 加入自己的事件循环, 可读时调用
+/// poll() 取出结果.
+class XAsyncLoader {
+public:
+  ///@param threads 解析线程数, 为 0 时使用硬件并发数.
+  explicit XAsyncLoader(unsigned threads = 0);
+  ///@brief 等待所有已提交的请求完成后返回.
+  ~XAsyncLoader();
+
+  XAsyncLoader(const XAsyncLoader&) = delete;
+  XAsyncLoader& operator = (const XAsyncLoader&) = delete;
+
+  ///@brief 提交一个加载请求并立即返回, 完成之前不得访问 doc.
+  /// 提供了 cb 时只通过回调通知, 否则结果进入完成队列, 由 poll()/wait()
+  /// 取出.
+  void submit(const std::string& path, XDocument *doc,
+              const XAsyncCallback& cb = XAsyncCallback(),
+              const XParseOptions& opts = XParseOptions());
+
+  ///@brief 完成队列非空时可读的文件描述符, 平台不支持时为 -1.
+  int  eventFd() const;
+  ///@brief 非阻塞地取出一个已完成的请求, 队列为空时返回 false.
+  bool poll(XDocument **doc, bool *ok);
+  ///@brief 阻塞直到取出一个已完成的请求.
+  void wait(XDocument **doc, bool *ok);
+
+  ///@brief 是否正在使用 io_uring. io_uring 出现无法恢复的错误时, 进行中
+  /// 的请求失败, 之后的请求改用 pread 读取, 此后返回 false.
+  bool usingIoUring() const;
+
+private:
+  struct Request;
+  struct Ring;
+
+  void parseLoop();
+  void ioLoop();
+  void ioLoopFallback();
+  void abandonRing(std::vector<Request *>& active);
+  bool process(Request *req, buffer_t *content);
+  void finish(Request *req, bool ok);
+  void takeCompleted(XDocument **doc, bool *ok);
+  void wakeIo();
+
+  std::vector<std::thread> workers_;
+  std::thread              io_;
+  Ring                    *ring_;
+  int                      doneFd_;
+  int                      wakeFd_;
+
+  std::mutex              mutex_;
+  std::condition_variable wake_;   // 通知解析线程有新请求.
+  std::condition_variable ioWake_; // 无 io_uring 时通知 I/O 线程.
+  std::condition_variable done_;   // 通知 wait() 有请求完成.
+
+  std::deque<Request *> queue_;    // 等待解析的请求.
+  std::deque<Request *> ioQueue_;  // 等待开始读取的请求.
+  std::deque<std::pair<XDocument *, bool>> completed_;
+
+  bool quit_;
+  bool ioQuit_;
+  std::atomic<bool> ringBroken_; // io_uring 出错后改用 pread.
+};
+
+#endif //LIBXDOC_ASYNC_H
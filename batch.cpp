@@ -0,0 +1,143 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#include "batch.h"
+#include "source.h"
+
+// 每个工作线程最多可以领先回调的结果数.
+#define XDOC_BATCH_WINDOW (4)
+
+static unsigned ThreadCount(unsigned threads) {
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  return threads ? threads : 1;
+}
+
+XBatchLoader::XBatchLoader(unsigned threads)
+: slots_(ThreadCount(threads) * XDOC_BATCH_WINDOW)
+{
+  job_ = nullptr;
+  quit_ = false;
+  threads = ThreadCount(threads);
+
+  for (size_t i = 0; i < slots_.size(); i++)
+    slots_[i].ready = false;
+
+  for (unsigned i = 0; i < threads; i++)
+    workers_.push_back(std::thread(&XBatchLoader::work, this));
+}
+
+XBatchLoader::~XBatchLoader() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    quit_ = true;
+  }
+  wake_.notify_all();
+
+  for (size_t i = 0; i < workers_.size(); i++)
+    workers_[i].join();
+}
+
+unsigned XBatchLoader::threads() const {
+  return (unsigned) workers_.size();
+}
+
+bool XBatchLoader::loadFiles(const std::vector<std::string>& paths,
+                             const XBatchCallback& cb,
+                             const XParseOptions& opts) {
+  Job job;
+  job.paths = &paths;
+  job.inputs = nullptr;
+  job.opts = &opts;
+  job.count = paths.size();
+  return run(job, cb);
+}
+
+bool XBatchLoader::loadBuffers(const std::vector<XMemoryInput>& inputs,
+                               const XBatchCallback& cb,
+                               const XParseOptions& opts) {
+  Job job;
+  job.paths = nullptr;
+  job.inputs = &inputs;
+  job.opts = &opts;
+  job.count = inputs.size();
+  return run(job, cb);
+}
+
+bool XBatchLoader::run(Job& job, const XBatchCallback& cb) {
+  const size_t total = job.count;
+  const size_t window = slots_.size();
+  bool ok = true, aborted = false;
+
+  job.next = 0;
+  job.delivered = 0;
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  job_ = &job;
+  wake_.notify_all();
+
+  // 按顺序等待每个结果, 回调期间不持有锁, 工作线程可以继续加载
+  // 窗口内的后续文档.
+  while (job.delivered < total) {
+    Slot& slot = slots_[job.delivered % window];
+    if (!slot.ready) {
+      // 中止后未被领取的任务不会再有结果.
+      if (job.delivered >= job.count)
+        break;
+      done_.wait(lk);
+      continue;
+    }
+
+    lk.unlock();
+    if (slot.doc.error() != xNoErr)
+      ok = false;
+    if (!aborted && !cb(job.delivered, slot.doc))
+      aborted = true;
+    slot.doc.clear();
+    lk.lock();
+
+    slot.ready = false;
+    job.delivered++;
+    if (aborted && job.count > job.next)
+      job.count = job.next;
+    wake_.notify_all();
+  }
+
+  job_ = nullptr;
+  return ok && !aborted;
+}
+
+void XBatchLoader::work() {
+  buffer_t content;
+  buffer_init(&content);
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    wake_.wait(lk, [this] {
+      return quit_ || (job_ != nullptr
+                    && job_->next < job_->count
+                    && job_->next < job_->delivered + slots_.size());
+    });
+    if (quit_)
+      break;
+
+    Job   *job = job_;
+    size_t i = job->next++;
+    Slot&  slot = slots_[i % slots_.size()];
+    lk.unlock();
+
+    if (job->paths) {
+      slot.doc.loadFile((*job->paths)[i], *job->opts, &content);
+    } else {
+      XMemorySource src((*job->inputs)[i].data, (*job->inputs)[i].len);
+      slot.doc.load(&src, *job->opts, &content);
+    }
+
+    lk.lock();
+    slot.ready = true;
+    done_.notify_all();
+  }
+
+  buffer_free(&content);
+}
@@ -0,0 +1,81 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_BATCH_H
+#define LIBXDOC_BATCH_H
+
+#include "document.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+///@brief 内存中的一份待加载文档.
+struct XMemoryInput {
+  const char *data;
+  size_t      len;
+};
+
+///@brief 批量加载的结果回调, 在调用 loadFiles/loadBuffers 的线程上按
+/// 输入顺序依次调用. doc 仅在回调期间有效, 加载失败时可以通过
+/// doc.error() 和 doc.errorText() 获得原因.
+/// 返回 false 将中止剩余的加载任务.
+typedef std::function<bool(size_t index, XDocument& doc)> XBatchCallback;
+
+///@brief 使用一组常驻的工作线程并发加载大量文档.
+/// 每个工作线程复用自己的读取缓冲区, 结果文档在一个有限的窗口内循环
+/// 使用, 旧文档的节点在下一次加载时被复用, 因此内存占用与输入数量无关.
+/// 同一个 XBatchLoader 不支持在多个线程上同时发起批量加载.
+class XBatchLoader {
+public:
+  ///@param threads 工作线程数, 为 0 时使用硬件并发数.
+  explicit XBatchLoader(unsigned threads = 0);
+  ~XBatchLoader();
+
+  XBatchLoader(const XBatchLoader&) = delete;
+  XBatchLoader& operator = (const XBatchLoader&) = delete;
+
+  unsigned threads() const;
+
+  ///@brief 加载全部文件, 全部成功时返回 true.
+  bool loadFiles(const std::vector<std::string>& paths,
+                 const XBatchCallback& cb,
+                 const XParseOptions& opts = XParseOptions());
+  ///@brief 加载内存中的文档, 数据在调用期间必须保持有效.
+  bool loadBuffers(const std::vector<XMemoryInput>& inputs,
+                   const XBatchCallback& cb,
+                   const XParseOptions& opts = XParseOptions());
+
+private:
+  struct Slot {
+    XDocument doc;
+    bool      ready;
+  };
+
+  struct Job {
+    const std::vector<std::string>  *paths;
+    const std::vector<XMemoryInput> *inputs;
+    const XParseOptions             *opts;
+
+    size_t count;     // 允许领取的任务总数, 中止时会被截短.
+    size_t next;      // 下一个待领取的下标.
+    size_t delivered; // 已经交给回调的数量.
+  };
+
+  bool run(Job& job, const XBatchCallback& cb);
+  void work();
+
+  std::vector<std::thread> workers_;
+  std::vector<Slot>        slots_;
+
+  std::mutex              mutex_;
+  std::condition_variable wake_; // 通知工作线程有新任务.
+  std::condition_variable done_; // 通知调用者有结果完成.
+
+  Job *job_;
+  bool quit_;
+};
+
+#endif //LIBXDOC_BATCH_H
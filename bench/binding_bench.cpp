@@ -0,0 +1,169 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+// 绑定的速度: XBinder 直接绑定与 XDocument 加载后遍历元素填充结构体
+// 的对比.
+//
+//   binding_bench [catalog.xml]
+//
+// 未给出文件时生成一份约 200MB 的目录文档到临时目录.
+
+#include "binding.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+struct Book {
+  std::string              id;
+  std::string              title;
+  std::string              author;
+  double                   price;
+  int                      year;
+  std::vector<std::string> tags;
+};
+
+struct Catalog {
+  std::vector<Book> books;
+};
+
+XBIND_BEGIN(Book)
+  XBIND_ATTR(id)
+  XBIND_ELEM(title)
+  XBIND_ELEM(author)
+  XBIND_ELEM(price)
+  XBIND_ELEM(year)
+  XBIND_ELEM_AS(tags, "tag")
+XBIND_END()
+
+XBIND_BEGIN(Catalog)
+  XBIND_ELEM_AS(books, "book")
+XBIND_END()
+
+static double Now() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool Generate(const std::string& path) {
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (fp == NULL)
+    return false;
+
+  std::string block;
+  char line[512];
+  block += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<catalog>\n";
+  for (int i = 0; i < 1000000; i++) {
+    snprintf(line, sizeof(line),
+             "  <book id=\"bk%d\" lang=\"en\">\n"
+             "    <title>The book number %d</title>\n"
+             "    <author>Author %d</author>\n"
+             "    <price>%d.%02d</price>\n"
+             "    <year>%d</year>\n"
+             "    <tag>fiction</tag><tag>series %d</tag>\n"
+             "  </book>\n",
+             i, i, i % 5000, i % 100, i % 100, 1900 + i % 120, i % 50);
+    block += line;
+    if (block.size() > 1024 * 1024) {
+      fwrite(block.data(), 1, block.size(), fp);
+      block.clear();
+    }
+  }
+  block += "</catalog>\n";
+  fwrite(block.data(), 1, block.size(), fp);
+  return fclose(fp) == 0;
+}
+
+static std::string Text(XElement *ele) {
+  XNode *n = ele->children.next();
+  return n == &ele->children ? std::string() : n->txt;
+}
+
+// 与绑定得到相同的结构体, 数值同样需要转换.
+static void Walk(XDocument& doc, Catalog *cat) {
+  ELEMENT_FOREACH(ele, doc.root()) {
+    cat->books.emplace_back();
+    Book& book = cat->books.back();
+    XAttribute *id = ele->findAttr("id");
+    if (id != nullptr)
+      book.id = id->val;
+
+    ELEMENT_FOREACH(field, ele) {
+      const std::string& name = field->name();
+      if (name == "title") {
+        book.title = Text(field);
+      } else if (name == "author") {
+        book.author = Text(field);
+      } else if (name == "price") {
+        book.price = strtod(Text(field).c_str(), nullptr);
+      } else if (name == "year") {
+        book.year = atoi(Text(field).c_str());
+      } else if (name == "tag") {
+        book.tags.push_back(Text(field));
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  std::string path = argc > 1 ? argv[1] : "/tmp/xdoc_binding_bench.xml";
+  if (argc <= 1 && !Generate(path)) {
+    fprintf(stderr, "failed to generate %s\n", path.c_str());
+    return 1;
+  }
+
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "can't open %s\n", path.c_str());
+    return 1;
+  }
+  fseek(fp, 0, SEEK_END);
+  double mb = ftell(fp) / 1048576.0;
+  fclose(fp);
+  printf("%s: %.1f MB\n", path.c_str(), mb);
+
+  double best[2] = { 1e9, 1e9 };
+  size_t count[2] = { 0, 0 };
+  XBinder binder;
+
+  for (int round = 0; round < 3; round++) {
+    // 直接绑定.
+    double t0 = Now();
+    {
+      Catalog cat;
+      if (!binder.load(path, cat, "catalog")) {
+        fprintf(stderr, "bind: %s\n", binder.errorText().c_str());
+        return 1;
+      }
+      count[0] = cat.books.size();
+    }
+    double t1 = Now();
+
+    // 先构建 DOM 再遍历, 文档的释放同样计入耗时.
+    {
+      XDocument doc;
+      if (!doc.load(path)) {
+        fprintf(stderr, "load: %s\n", doc.errorText().c_str());
+        return 1;
+      }
+      Catalog cat;
+      Walk(doc, &cat);
+      count[1] = cat.books.size();
+    }
+    double t2 = Now();
+
+    best[0] = std::min(best[0], t1 - t0);
+    best[1] = std::min(best[1], t2 - t1);
+  }
+
+  const char *names[2] = { "XBinder::load", "XDocument::load + walk" };
+  for (int i = 0; i < 2; i++)
+    printf("%-32s %8.1f ms %8.1f MB/s %zu books\n", names[i], best[i] * 1000,
+           mb / best[i], count[i]);
+  printf("speedup %.2fx\n", best[1] / best[0]);
+  return 0;
+}
@@ -0,0 +1,165 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+// 压缩输入的加载速度: 边解压边解析与先解压再解析的对比.
+//
+//   inflate_bench [file.xml.gz]
+//
+// 未给出文件时生成一份约 200MB 的文档并压缩到临时目录.
+
+#include "document.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string>
+
+#ifdef XDOC_HAVE_ZLIB
+#include <zlib.h>
+
+static double Now() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static bool Generate(const std::string& path) {
+  gzFile gz = gzopen(path.c_str(), "wb6");
+  if (gz == nullptr)
+    return false;
+
+  std::string block;
+  char line[256];
+  gzputs(gz, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<feed>\n");
+  for (int i = 0; i < 1000000; i++) {
+    snprintf(line, sizeof(line),
+             "  <entry id=\"%d\" lang=\"en\"><title>entry number %d</title>"
+             "<price currency=\"EUR\">%d.%02d</price><tag>a</tag><tag>b</tag>"
+             "</entry>\n", i, i, i % 1000, i % 100);
+    block += line;
+    if (block.size() > 1024 * 1024) {
+      gzwrite(gz, block.data(), (unsigned) block.size());
+      block.clear();
+    }
+  }
+  block += "</feed>\n";
+  gzwrite(gz, block.data(), (unsigned) block.size());
+  return gzclose(gz) == Z_OK;
+}
+
+static bool Inflate(const std::string& path, std::string *out) {
+  gzFile gz = gzopen(path.c_str(), "rb");
+  if (gz == nullptr)
+    return false;
+  gzbuffer(gz, 256 * 1024);
+
+  out->clear();
+  char buf[1024 * 1024];
+  int  rn;
+  while ((rn = gzread(gz, buf, sizeof(buf))) > 0)
+    out->append(buf, rn);
+  gzclose(gz);
+  return rn == 0;
+}
+
+static bool InflateToFile(const std::string& path, const std::string& dst) {
+  gzFile gz = gzopen(path.c_str(), "rb");
+  if (gz == nullptr)
+    return false;
+  FILE *fp = fopen(dst.c_str(), "wb");
+  if (fp == nullptr) {
+    gzclose(gz);
+    return false;
+  }
+  gzbuffer(gz, 256 * 1024);
+
+  char buf[1024 * 1024];
+  int  rn;
+  bool failed = false;
+  while ((rn = gzread(gz, buf, sizeof(buf))) > 0) {
+    if (fwrite(buf, 1, rn, fp) != (size_t) rn) {
+      failed = true;
+      break;
+    }
+  }
+  gzclose(gz);
+  if (fclose(fp) != 0)
+    failed = true;
+  return !failed && rn == 0;
+}
+
+int main(int argc, char **argv) {
+  std::string path = argc > 1 ? argv[1] : "/tmp/xdoc_inflate_bench.xml.gz";
+  if (argc <= 1 && !Generate(path)) {
+    fprintf(stderr, "failed to generate %s\n", path.c_str());
+    return 1;
+  }
+
+  std::string plain;
+  if (!Inflate(path, &plain)) {
+    fprintf(stderr, "failed to decompress %s\n", path.c_str());
+    return 1;
+  }
+  double mb = plain.size() / 1048576.0;
+  printf("%s: %.1f MB decompressed\n", path.c_str(), mb);
+
+  std::string tmp = path + ".tmp.xml";
+  double best[3] = { 1e9, 1e9, 1e9 };
+  XDocument doc;
+
+  for (int round = 0; round < 3; round++) {
+    // 边解压边解析.
+    double t0 = Now();
+    if (!doc.load(path)) {
+      fprintf(stderr, "load: %s\n", doc.errorText().c_str());
+      return 1;
+    }
+    double t1 = Now();
+
+    // 先解压到内存再解析.
+    std::string data;
+    if (!Inflate(path, &data)) {
+      fprintf(stderr, "failed to decompress %s\n", path.c_str());
+      return 1;
+    }
+    if (!doc.loadBuffer(data.data(), data.size())) {
+      fprintf(stderr, "loadBuffer: %s\n", doc.errorText().c_str());
+      return 1;
+    }
+    double t2 = Now();
+
+    // 先解压到临时文件再加载, 解压与写入都计入耗时.
+    if (!InflateToFile(path, tmp)) {
+      fprintf(stderr, "failed to decompress %s to %s\n", path.c_str(),
+              tmp.c_str());
+      return 1;
+    }
+    if (!doc.load(tmp)) {
+      fprintf(stderr, "load: %s\n", doc.errorText().c_str());
+      return 1;
+    }
+    double t3 = Now();
+
+    best[0] = std::min(best[0], t1 - t0);
+    best[1] = std::min(best[1], t2 - t1);
+    best[2] = std::min(best[2], t3 - t2);
+  }
+  remove(tmp.c_str());
+
+  const char *names[3] = {
+    "pipelined", "inflate to memory, then parse", "inflate to file, then load",
+  };
+  for (int i = 0; i < 3; i++)
+    printf("%-32s %8.1f ms %8.1f MB/s\n", names[i], best[i] * 1000,
+           mb / best[i]);
+  return 0;
+}
+
+#else
+
+int main() {
+  fprintf(stderr, "inflate_bench requires zlib\n");
+  return 1;
+}
+
+#endif
@@ -0,0 +1,342 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#include "binding.h"
+#include "parser.h"
+#include "source.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+// 数值文本(去除首尾空白后)的最大长度.
+#define XBIND_NUMBER_MAX (64)
+
+// 去除首尾空白后复制到 buf 中, 以便交给 strto* 转换.
+static bool CopyNumber(const char *b, const char *e, char *buf) {
+  while (b < e && IS_BLANK(*b))       b++;
+  while (b < e && IS_BLANK(*(e - 1))) e--;
+  if (b == e || e - b >= XBIND_NUMBER_MAX)
+    return true;
+
+  memcpy(buf, b, e - b);
+  buf[e - b] = '\0';
+  return false;
+}
+
+bool XBindParseInt(const char *b, const char *e, long long *v) {
+  char buf[XBIND_NUMBER_MAX], *stop;
+  if (CopyNumber(b, e, buf))
+    return true;
+
+  errno = 0;
+  *v = strtoll(buf, &stop, 10);
+  return *stop != '\0' || errno == ERANGE;
+}
+
+bool XBindParseUInt(const char *b, const char *e, unsigned long long *v) {
+  char buf[XBIND_NUMBER_MAX], *stop;
+  if (CopyNumber(b, e, buf) || buf[0] == '-')
+    return true;
+
+  errno = 0;
+  *v = strtoull(buf, &stop, 10);
+  return *stop != '\0' || errno == ERANGE;
+}
+
+bool XBindParseFloat(const char *b, const char *e, double *v) {
+  char buf[XBIND_NUMBER_MAX], *stop;
+  if (CopyNumber(b, e, buf))
+    return true;
+
+  errno = 0;
+  *v = strtod(buf, &stop);
+  return *stop != '\0' || errno == ERANGE;
+}
+
+bool XBindParseBool(const char *b, const char *e, bool *v) {
+  // xsd:boolean ::= 'true' | 'false' | '1' | '0'
+  char buf[XBIND_NUMBER_MAX];
+  if (CopyNumber(b, e, buf))
+    return true;
+
+  if (strcmp(buf, "true") == 0 || strcmp(buf, "1") == 0) {
+    *v = true;
+  } else if (strcmp(buf, "false") == 0 || strcmp(buf, "0") == 0) {
+    *v = false;
+  } else {
+    return true;
+  }
+  return false;
+}
+
+XBinder::XBinder() {
+  buffer_init(&content_);
+  parser_ = nullptr;
+  abeg_ = aend_ = nullptr;
+  name_ = nullptr;
+  nameLen_ = 0;
+  inAttr_ = false;
+}
+
+XBinder::~XBinder() {
+  buffer_free(&content_);
+}
+
+XError XBinder::error() {
+  return doc_.error();
+}
+
+std::string XBinder::errorText() {
+  return doc_.errorText();
+}
+
+size_t XBinder::errorOffset() {
+  return doc_.errorOffset();
+}
+
+bool XBinder::loadFile(const std::string& path, const XParseOptions& opts,
+                       const char *root, void *obj, XBindFn fn) {
+  doc_.clear();
+
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == NULL) {
+    doc_.setError(xErrBadFile, "can't open the xml file");
+    return false;
+  }
+
+  XFileSource src(fp);
+  content_.len = 0;
+  bool res = !doc_.readSource(&src, opts, &content_);
+
+  fclose(fp);
+  return res && bind(opts, root, obj, fn);
+}
+
+bool XBinder::loadBuffer(const char *data, size_t len,
+                         const XParseOptions& opts,
+                         const char *root, void *obj, XBindFn fn) {
+  doc_.clear();
+
+  XMemorySource src(data, len);
+  content_.len = 0;
+  if (doc_.readSource(&src, opts, &content_))
+    return false;
+
+  return bind(opts, root, obj, fn);
+}
+
+bool XBinder::bind(const XParseOptions& opts,
+                   const char *root, void *obj, XBindFn fn) {
+  buffer_terminate(&content_);
+
+  XParser parser;
+  parser.begin = content_.data;
+  parser.curr = content_.data;
+  parser.end = content_.data + content_.len;
+  parser.opts = &opts;
+  parser.order = 0;
+  parser.feed = nullptr;
+  parser.doc = &doc_;
+  parser_ = &parser;
+
+  ContentPtr nbeg, nend;
+  bool failed = parser.parseProlog() || parser.SkipMisc()
+             || *(parser.curr++) != '<'
+             || parser.MatchName(nbeg, nend);
+
+  if (!failed) {
+    name_ = nbeg;
+    nameLen_ = nend - nbeg;
+    if (root != nullptr
+     && (strlen(root) != nameLen_ || memcmp(root, name_, nameLen_) != 0)) {
+      doc_.setError(xErrParse, "unexpected root element");
+      failed = true;
+    } else {
+      failed = bindStruct(obj, fn);
+    }
+  }
+
+  parser_ = nullptr;
+  if (failed && doc_.error() == xNoErr)
+    doc_.setError(xErrParse, "failed to parse the xml content");
+  return !failed;
+}
+
+bool XBinder::bindAttrs(void *obj, XBindFn fn) {
+  // 读取当前元素的属性直到 '>' 或 '/', fn 为空时丢弃.
+  XParser& p = *parser_;
+  ContentPtr nbeg, nend;
+
+  if (p.SkipBlank()) return true;
+  while (*p.curr != '>' && *p.curr != '/') {
+    if (p.MatchName(nbeg, nend)) return true;
+    if (p.SkipBlank()) return true;
+    if (*(p.curr++) != '=') return true;
+    if (p.SkipBlank()) return true;
+    if (p.MatchRefVal(abeg_, aend_)) return true;
+
+    if (fn != nullptr) {
+      name_ = nbeg;
+      nameLen_ = nend - nbeg;
+      inAttr_ = true;
+      if (fn(*this, obj, xBindAttr, nbeg, nend - nbeg)) return true;
+      inAttr_ = false;
+    }
+
+    nbeg = p.curr;
+    if (p.SkipBlank()) return true;
+    if (nbeg == p.curr && *p.curr != '>' && *p.curr != '/') return true;
+  }
+
+  return false;
+}
+
+bool XBinder::matchEndTag(const char *name, size_t len) {
+  // curr 位于 "</" 之后.
+  XParser& p = *parser_;
+  ContentPtr nbeg, nend;
+
+  if (p.MatchName(nbeg, nend)) return true;
+  if ((size_t) (nend - nbeg) != len || memcmp(nbeg, name, len) != 0)
+    return true;
+  if (p.SkipBlank()) return true;
+  return *(p.curr++) != '>';
+}
+
+bool XBinder::bindStruct(void *obj, XBindFn fn) {
+  XParser& p = *parser_;
+  const char *name = name_;
+  size_t      len = nameLen_;
+
+  if (bindAttrs(obj, fn)) return true;
+
+  if (*(p.curr++) == '/') {
+    if (p.IsEnd()) return true;
+    return *(p.curr++) != '>';
+  }
+
+  // 结构体元素的文本被忽略.
+  while (true) {
+    if (p.FindChar('<')) return true;
+    p.curr++;
+    if (p.IsEnd()) return true;
+
+    if (*p.curr == '/') {
+      p.curr++;
+      return matchEndTag(name, len);
+    } else if (*p.curr == '!') {
+      if (p.Avail(3) && memcmp(p.curr, "!--", 3) == 0) {
+        if (p.SkipTo("-->", 3)) return true;
+      } else if (p.Avail(8) && memcmp(p.curr, "![CDATA[", 8) == 0) {
+        if (p.SkipTo("]]>", 3)) return true;
+      } else {
+        return true;
+      }
+    } else if (*p.curr == '?') {
+      if (p.SkipTo("?>", 2)) return true;
+    } else {
+      ContentPtr nbeg, nend;
+      if (p.MatchName(nbeg, nend)) return true;
+      // 被过滤的元素即使有对应的字段也不绑定.
+      if (p.IsSkipped(nbeg, nend)) {
+        if (p.SkipElement()) return true;
+        continue;
+      }
+      name_ = nbeg;
+      nameLen_ = nend - nbeg;
+      if (fn(*this, obj, xBindElement, nbeg, nend - nbeg)) return true;
+    }
+  }
+}
+
+bool XBinder::text(const char **b, const char **e) {
+  XParser& p = *parser_;
+  const char *name = name_;
+  size_t      len = nameLen_;
+
+  if (bindAttrs(nullptr, nullptr)) return true;
+
+  if (*(p.curr++) == '/') {
+    if (p.IsEnd() || *(p.curr++) != '>') return true;
+    *b = *e = p.curr;
+    return false;
+  }
+
+  // 最常见的情况是内容中只有一段文本, 直接返回其在内容中的位置.
+  ContentPtr tbeg = p.curr;
+  if (p.FindChar('<')) return true;
+  ContentPtr tend = p.curr;
+  bool joined = false;
+
+  while (true) {
+    p.curr++;
+    if (p.IsEnd()) return true;
+
+    if (*p.curr == '/') {
+      p.curr++;
+      if (matchEndTag(name, len)) return true;
+      break;
+    }
+
+    if (!joined) {
+      text_.assign(tbeg, tend - tbeg);
+      joined = true;
+    }
+
+    if (*p.curr == '!') {
+      if (p.Avail(3) && memcmp(p.curr, "!--", 3) == 0) {
+        if (p.SkipTo("-->", 3)) return true;
+      } else if (p.Avail(8) && memcmp(p.curr, "![CDATA[", 8) == 0) {
+        ContentPtr cbeg = p.curr + 8;
+        if (p.SkipTo("]]>", 3)) return true;
+        text_.append(cbeg, p.curr - 3 - cbeg);
+      } else {
+        return true;
+      }
+    } else if (*p.curr == '?') {
+      if (p.SkipTo("?>", 2)) return true;
+    } else {
+      ContentPtr nbeg, nend;
+      if (p.MatchName(nbeg, nend)) return true;
+      if (p.SkipElement()) return true;
+    }
+
+    tbeg = p.curr;
+    if (p.FindChar('<')) return true;
+    text_.append(tbeg, p.curr - tbeg);
+  }
+
+  if (joined) {
+    *b = text_.data();
+    *e = text_.data() + text_.length();
+  } else {
+    *b = tbeg;
+    *e = tend;
+  }
+  if (p.opts->trimText) {
+    while (*b < *e && IS_BLANK(**b))       (*b)++;
+    while (*b < *e && IS_BLANK(*(*e - 1))) (*e)--;
+  }
+  name_ = name;
+  nameLen_ = len;
+  return false;
+}
+
+bool XBinder::skip(XBindKind kind) {
+  if (kind == xBindAttr)
+    return false;
+  return parser_->SkipElement();
+}
+
+bool XBinder::check(bool invalid) {
+  if (!invalid)
+    return false;
+
+  std::string txt = inAttr_ ? "invalid value of attribute '"
+                            : "invalid value of element '";
+  txt.append(name_, nameLen_);
+  txt.append("'");
+  doc_.setError(xErrParse, txt.c_str());
+  return true;
+}
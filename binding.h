@@ -0,0 +1,307 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_BINDING_H
+#define LIBXDOC_BINDING_H
+
+#include "document.h"
+
+#include <limits>
+#include <stdint.h>
+#include <string.h>
+
+///@brief 直接把 xml 绑定到 C++ 结构体, 解析时不构建 DOM, 也不分配任何节点.
+/// 每个结构体在全局命名空间中用一组宏描述其字段:
+///
+///   struct Book {
+///     std::string              id;
+///     std::string              title;
+///     double                   price;
+///     std::vector<std::string> tags;
+///     Author                   author;
+///   };
+///
+///   XBIND_BEGIN(Book)
+///     XBIND_ATTR(id)
+///     XBIND_ELEM(title)
+///     XBIND_ELEM(price)
+///     XBIND_ELEM_AS(tags, "tag")
+///     XBIND_ELEM(author)
+///   XBIND_END()
+///
+/// 宏展开为一个以名字哈希为 case 的 switch, 名字的分派在编译期生成.
+/// 同一结构体中两个名字的哈希相同时编译器会报告重复的 case.
+///
+/// 字段可以是字符串, 数值, bool, 描述过的结构体, 以及它们的 std::vector
+/// (每出现一次同名子元素追加一项). 属性只能绑定到前三种值类型. 其他类型
+/// 可以通过特化 XBindValue 支持. 未描述的属性与子元素被跳过, 文本与 DOM
+/// 一样保持原样, 不展开实体引用.
+
+enum XBindKind {
+  xBindAttr    = 1,
+  xBindElement = 2,
+};
+
+class XBinder;
+
+typedef bool (*XBindFn)(XBinder& b, void *obj, XBindKind kind,
+                        const char *name, size_t len);
+
+///@brief 名字的 FNV-1a 哈希, 以 kind 作为种子区分属性与元素.
+constexpr uint32_t XBindHashStep(const char *s, size_t n, uint32_t h) {
+  return n == 0 ? h : XBindHashStep(s + 1, n - 1,
+                                    (h ^ (uint8_t) *s) * 16777619u);
+}
+
+constexpr uint32_t XBindHash(XBindKind kind, const char *s, size_t n) {
+  return XBindHashStep(s, n, 2166136261u ^ (uint32_t) kind);
+}
+
+///@brief 与 XBindHash 相同, 供运行时使用.
+inline uint32_t XBindHashOf(XBindKind kind, const char *s, size_t n) {
+  uint32_t h = 2166136261u ^ (uint32_t) kind;
+  for (size_t i = 0; i < n; i++)
+    h = (h ^ (uint8_t) s[i]) * 16777619u;
+  return h;
+}
+
+///@brief 由 XBIND_BEGIN/XBIND_END 为每个结构体特化.
+template <typename T>
+struct XBinding;
+
+///@brief 文本到值的转换, 出错时返回 true.
+template <typename T>
+struct XBindValue {
+  static const bool defined = false;
+};
+
+bool XBindParseInt(const char *b, const char *e, long long *v);
+bool XBindParseUInt(const char *b, const char *e, unsigned long long *v);
+bool XBindParseFloat(const char *b, const char *e, double *v);
+bool XBindParseBool(const char *b, const char *e, bool *v);
+
+template <>
+struct XBindValue<std::string> {
+  static const bool defined = true;
+  static bool parse(const char *b, const char *e, std::string& v) {
+    v.assign(b, e - b);
+    return false;
+  }
+};
+
+template <>
+struct XBindValue<bool> {
+  static const bool defined = true;
+  static bool parse(const char *b, const char *e, bool& v) {
+    return XBindParseBool(b, e, &v);
+  }
+};
+
+#define XBIND_SIGNED_VALUE(T)                                         \
+  template <>                                                         \
+  struct XBindValue<T> {                                              \
+    static const bool defined = true;                                 \
+    static bool parse(const char *b, const char *e, T& v) {           \
+      long long n;                                                    \
+      if (XBindParseInt(b, e, &n)                                     \
+       || n < (long long) std::numeric_limits<T>::min()               \
+       || n > (long long) std::numeric_limits<T>::max())              \
+        return true;                                                  \
+      v = (T) n;                                                      \
+      return false;                                                   \
+    }                                                                 \
+  };
+
+#define XBIND_UNSIGNED_VALUE(T)                                       \
+  template <>                                                         \
+  struct XBindValue<T> {                                              \
+    static const bool defined = true;                                 \
+    static bool parse(const char *b, const char *e, T& v) {           \
+      unsigned long long n;                                           \
+      if (XBindParseUInt(b, e, &n)                                    \
+       || n > (unsigned long long) std::numeric_limits<T>::max())     \
+        return true;                                                  \
+      v = (T) n;                                                      \
+      return false;                                                   \
+    }                                                                 \
+  };
+
+#define XBIND_FLOAT_VALUE(T)                                          \
+  template <>                                                         \
+  struct XBindValue<T> {                                              \
+    static const bool defined = true;                                 \
+    static bool parse(const char *b, const char *e, T& v) {           \
+      double n;                                                       \
+      if (XBindParseFloat(b, e, &n))                                  \
+        return true;                                                  \
+      v = (T) n;                                                      \
+      return false;                                                   \
+    }                                                                 \
+  };
+
+XBIND_SIGNED_VALUE(short)
+XBIND_SIGNED_VALUE(int)
+XBIND_SIGNED_VALUE(long)
+XBIND_SIGNED_VALUE(long long)
+XBIND_UNSIGNED_VALUE(unsigned short)
+XBIND_UNSIGNED_VALUE(unsigned int)
+XBIND_UNSIGNED_VALUE(unsigned long)
+XBIND_UNSIGNED_VALUE(unsigned long long)
+XBIND_FLOAT_VALUE(float)
+XBIND_FLOAT_VALUE(double)
+
+template <typename T>
+bool XBindThunk(XBinder& b, void *obj, XBindKind kind,
+                const char *name, size_t len) {
+  return XBinding<T>::bind(b, *(T *) obj, kind, name, len);
+}
+
+///@brief 元素到字段的绑定, 按字段类型分为结构体, 值与 vector.
+template <typename T, bool = XBindValue<T>::defined>
+struct XBindElement;
+
+struct XParser;
+
+///@brief 绑定的执行者. 文件的读取, 解压, 编码探测与转码和 XDocument
+/// 相同, 读取缓冲区在多次加载之间复用. 压缩的输入在绑定之前整个解压.
+///
+/// 解析选项中的 validateUTF8 照常生效, trimText 去除绑定到值的文本首尾
+/// 的空白, skipElements 中的子元素即使有对应的字段也被跳过. 其余选项
+/// 只影响 DOM 的构建, 在此没有作用.
+class XBinder {
+public:
+  XBinder();
+  ~XBinder();
+
+  XBinder(const XBinder&) = delete;
+  XBinder& operator = (const XBinder&) = delete;
+
+  ///@brief 加载文件并绑定到 obj, root 不为空时要求根元素名与之相同.
+  template <typename T>
+  bool load(const std::string& path, T& obj, const char *root = nullptr,
+            const XParseOptions& opts = XParseOptions()) {
+    return loadFile(path, opts, root, &obj, &XBindThunk<T>);
+  }
+
+  template <typename T>
+  bool loadBuffer(const char *data, size_t len, T& obj,
+                  const char *root = nullptr,
+                  const XParseOptions& opts = XParseOptions()) {
+    return loadBuffer(data, len, opts, root, &obj, &XBindThunk<T>);
+  }
+
+  XError      error();
+  std::string errorText();
+  size_t      errorOffset();
+
+  // 以下供 XBIND_* 宏展开的代码使用.
+
+  template <typename T>
+  bool attr(T& v) {
+    static_assert(XBindValue<T>::defined,
+                  "attributes can only be bound to value types");
+    return check(XBindValue<T>::parse(abeg_, aend_, v));
+  }
+
+  template <typename T>
+  bool element(T& v) {
+    return XBindElement<T>::bind(*this, v);
+  }
+
+  ///@brief 跳过未描述的属性(值已读取)或元素.
+  bool skip(XBindKind kind);
+  ///@brief 按 fn 绑定当前元素的属性与子元素.
+  bool bindStruct(void *obj, XBindFn fn);
+  ///@brief 读取当前元素的文本内容, 忽略其中的注释与子元素.
+  bool text(const char **b, const char **e);
+  ///@brief 值转换失败(invalid 为 true)时记录错误.
+  bool check(bool invalid);
+
+private:
+  bool loadFile(const std::string& path, const XParseOptions& opts,
+                const char *root, void *obj, XBindFn fn);
+  bool loadBuffer(const char *data, size_t len, const XParseOptions& opts,
+                  const char *root, void *obj, XBindFn fn);
+  bool bind(const XParseOptions& opts,
+            const char *root, void *obj, XBindFn fn);
+  bool bindAttrs(void *obj, XBindFn fn);
+  bool matchEndTag(const char *name, size_t len);
+
+  // 仅用于读取内容和记录错误, 不会创建任何节点.
+  XDocument doc_;
+  buffer_t  content_;
+  XParser  *parser_;
+
+  // 当前的属性值与元素名, 位于 content_ 中.
+  const char *abeg_, *aend_;
+  const char *name_;
+  size_t      nameLen_;
+  bool        inAttr_;
+
+  std::string text_; // 文本被注释或子元素分隔时拼接于此.
+};
+
+template <typename T, bool>
+struct XBindElement {
+  static bool bind(XBinder& b, T& v) {
+    return b.bindStruct(&v, &XBindThunk<T>);
+  }
+};
+
+template <typename T>
+struct XBindElement<T, true> {
+  static bool bind(XBinder& b, T& v) {
+    const char *tb, *te;
+    if (b.text(&tb, &te)) return true;
+    return b.check(XBindValue<T>::parse(tb, te, v));
+  }
+};
+
+template <typename T, typename A>
+struct XBindElement<std::vector<T, A>, false> {
+  static bool bind(XBinder& b, std::vector<T, A>& v) {
+    v.emplace_back();
+    return XBindElement<T>::bind(b, v.back());
+  }
+};
+
+// std::vector<bool> 的元素是代理对象, 先读入局部变量再追加.
+template <typename A>
+struct XBindElement<std::vector<bool, A>, false> {
+  static bool bind(XBinder& b, std::vector<bool, A>& v) {
+    bool item = false;
+    if (XBindElement<bool>::bind(b, item)) return true;
+    v.push_back(item);
+    return false;
+  }
+};
+
+#define XBIND_BEGIN(Type)                                             \
+  template <>                                                         \
+  struct XBinding<Type> {                                             \
+    static bool bind(XBinder& b, Type& obj, XBindKind kind,           \
+                     const char *name, size_t len) {                  \
+      switch (XBindHashOf(kind, name, len)) {
+
+#define XBIND_FIELD(k, method, field, tag)                            \
+      case XBindHash(k, tag, sizeof(tag) - 1):                        \
+        if (kind == k && len == sizeof(tag) - 1                       \
+         && memcmp(name, tag, len) == 0)                              \
+          return b.method(obj.field);                                 \
+        break;
+
+#define XBIND_ATTR_AS(field, tag) XBIND_FIELD(xBindAttr, attr, field, tag)
+#define XBIND_ELEM_AS(field, tag) XBIND_FIELD(xBindElement, element, field, tag)
+#define XBIND_ATTR(field) XBIND_ATTR_AS(field, #field)
+#define XBIND_ELEM(field) XBIND_ELEM_AS(field, #field)
+
+#define XBIND_END()                                                   \
+      default:                                                        \
+        break;                                                        \
+      }                                                               \
+      return b.skip(kind);                                            \
+    }                                                                 \
+  };
+
+#endif //LIBXDOC_BINDING_H
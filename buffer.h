@@ -0,0 +1,62 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_BUFFER_H
+#define LIBXDOC_BUFFER_H
+
+// 可增长的连续字节缓冲区, 用于存放加载时读入或转码后的文档内容.
+// 容量之外总是额外保留 BUFFER_PADDING 个字节并以 '\0' 结尾, 解析器
+// 在末尾附近向前窥视若干字节时不会越界.
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_PADDING (64)
+
+typedef struct buffer {
+  char  *data;
+  size_t len;
+  size_t cap;
+} buffer_t;
+
+static void buffer_init(buffer_t *buf) {
+  buf->data = NULL;
+  buf->len  = 0;
+  buf->cap  = 0;
+}
+
+static void buffer_free(buffer_t *buf) {
+  free(buf->data);
+  buffer_init(buf);
+}
+
+// 确保缓冲区还能再追加 n 个字节, 容量按倍数增长.
+// 返回 true 表示内存不足.
+static bool buffer_reserve(buffer_t *buf, size_t n) {
+  if (buf->cap - buf->len >= n && buf->data != NULL)
+    return false;
+
+  if (n > ((size_t) -1) / 2 - BUFFER_PADDING - buf->len)
+    return true;
+
+  size_t cap = buf->cap * 2;
+  if (cap < buf->len + n) cap = buf->len + n;
+  if (cap < 4096)         cap = 4096;
+
+  char *data = (char *) realloc(buf->data, cap + BUFFER_PADDING);
+  if (data == NULL)
+    return true;
+
+  buf->data = data;
+  buf->cap  = cap;
+  return false;
+}
+
+// 在内容末尾写入填充字节, 交给解析器之前调用.
+static void buffer_terminate(buffer_t *buf) {
+  if (buf->data != NULL)
+    memset(buf->data + buf->len, 0, BUFFER_PADDING);
+}
+
+#endif //LIBXDOC_BUFFER_H
@@ -0,0 +1,324 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#include "compress.h"
+#include "buffer.h"
+
+#include <sys/mman.h>
+
+#ifdef XDOC_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef XDOC_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// 为解压结果预留的地址空间. 只有写入的页面才占用内存.
+#define XDOC_INFLATE_RESERVE \
+  (sizeof(void *) >= 8 ? ((size_t) 1 << 40) : ((size_t) 1 << 30))
+
+XCompression XDetectCompression(const char *data, size_t len) {
+  const unsigned char *p = (const unsigned char *) data;
+  if (len >= 2 && p[0] == 0x1F && p[1] == 0x8B)
+    return xCompressGzip;
+  if (len >= 4 && p[0] == 0x28 && p[1] == 0xB5 && p[2] == 0x2F
+   && p[3] == 0xFD)
+    return xCompressZstd;
+  return xCompressNone;
+}
+
+XInflateSource::XInflateSource(XSource *s, XCompression c) {
+  src = s;
+  comp = c;
+  supported = false;
+  corrupt = false;
+  ctx_ = nullptr;
+  in_ = (char *) malloc(XDOC_INFLATE_INPUT);
+  inPos_ = inLen_ = 0;
+  inEnd_ = false;
+  done_ = false;
+  hint_ = 1;
+
+  if (in_ == nullptr) {
+    failed = true;
+    return;
+  }
+
+#ifdef XDOC_HAVE_ZLIB
+  if (comp == xCompressGzip) {
+    z_stream *zs = new z_stream();
+    // 32 表示自动识别 gzip 与 zlib 头.
+    if (inflateInit2(zs, 15 + 32) != Z_OK) {
+      delete zs;
+      failed = true;
+      return;
+    }
+    ctx_ = zs;
+    supported = true;
+  }
+#endif
+
+#ifdef XDOC_HAVE_ZSTD
+  if (comp == xCompressZstd) {
+    ZSTD_DStream *zs = ZSTD_createDStream();
+    if (zs == nullptr) {
+      failed = true;
+      return;
+    }
+    ZSTD_initDStream(zs);
+    ctx_ = zs;
+    supported = true;
+  }
+#endif
+
+  if (!supported)
+    failed = true;
+}
+
+XInflateSource::~XInflateSource() {
+#ifdef XDOC_HAVE_ZLIB
+  if (comp == xCompressGzip && ctx_ != nullptr) {
+    inflateEnd((z_stream *) ctx_);
+    delete (z_stream *) ctx_;
+  }
+#endif
+
+#ifdef XDOC_HAVE_ZSTD
+  if (comp == xCompressZstd && ctx_ != nullptr)
+    ZSTD_freeDStream((ZSTD_DStream *) ctx_);
+#endif
+
+  free(in_);
+}
+
+bool XInflateSource::refill() {
+  // 输入已经耗尽时才调用, 没有更多输入时返回 true.
+  if (inEnd_)
+    return true;
+  inPos_ = 0;
+  inLen_ = src->read(in_, XDOC_INFLATE_INPUT);
+  if (inLen_ == 0) {
+    inEnd_ = true;
+    if (src->failed)
+      failed = true;
+    return true;
+  }
+  return false;
+}
+
+size_t XInflateSource::read(char *buf, size_t n) {
+  if (failed || done_ || n == 0)
+    return 0;
+
+  size_t got = 0;
+  if (comp == xCompressGzip)
+    got = inflateGzip(buf, n);
+  else if (comp == xCompressZstd)
+    got = inflateZstd(buf, n);
+  return failed ? 0 : got;
+}
+
+size_t XInflateSource::inflateGzip(char *buf, size_t n) {
+#ifdef XDOC_HAVE_ZLIB
+  z_stream *zs = (z_stream *) ctx_;
+  size_t    got = 0;
+
+  while (got < n) {
+    // 每次最多提交 1GB, avail_* 只有 32 位.
+    size_t out = n - got < ((size_t) 1 << 30) ? n - got : ((size_t) 1 << 30);
+    zs->next_in = (Bytef *) in_ + inPos_;
+    zs->avail_in = (uInt) (inLen_ - inPos_);
+    zs->next_out = (Bytef *) buf + got;
+    zs->avail_out = (uInt) out;
+
+    int rc = inflate(zs, Z_NO_FLUSH);
+    inPos_ = inLen_ - zs->avail_in;
+    got += out - zs->avail_out;
+
+    if (rc == Z_STREAM_END) {
+      // 一个成员结束, 之后可能还有首尾相接的成员(如 pigz 的输出),
+      // 不以 gzip 魔数开头的尾部数据被忽略.
+      if (inPos_ == inLen_ && refill()) {
+        done_ = true;
+        break;
+      }
+      if ((unsigned char) in_[inPos_] != 0x1F) {
+        done_ = true;
+        break;
+      }
+      inflateReset(zs);
+    } else if (rc == Z_OK || rc == Z_BUF_ERROR) {
+      // 输出未满且输入已经用完时需要更多输入.
+      if (zs->avail_out != 0 && inPos_ == inLen_ && refill()) {
+        if (!failed) {
+          failed = true;
+          corrupt = true; // 成员被截断.
+        }
+        break;
+      }
+    } else {
+      failed = true;
+      corrupt = true;
+      break;
+    }
+  }
+  return got;
+#else
+  (void) buf;
+  (void) n;
+  return 0;
+#endif
+}
+
+size_t XInflateSource::inflateZstd(char *buf, size_t n) {
+#ifdef XDOC_HAVE_ZSTD
+  ZSTD_DStream *zs = (ZSTD_DStream *) ctx_;
+  ZSTD_outBuffer out = { buf, n, 0 };
+
+  while (out.pos < out.size) {
+    ZSTD_inBuffer in = { in_, inLen_, inPos_ };
+    size_t rc = ZSTD_decompressStream(zs, &out, &in);
+    inPos_ = in.pos;
+
+    if (ZSTD_isError(rc)) {
+      failed = true;
+      corrupt = true;
+      break;
+    }
+    hint_ = rc;
+
+    // 输出未满且输入已经用完时才需要读取更多输入, 否则解压器内部
+    // 可能还有尚未输出的内容.
+    if (out.pos < out.size && inPos_ == inLen_ && refill()) {
+      if (failed) break;
+      if (hint_ != 0) {
+        failed = true;
+        corrupt = true; // 帧被截断.
+      }
+      done_ = true;
+      break;
+    }
+  }
+  return out.pos;
+#else
+  (void) buf;
+  (void) n;
+  return 0;
+#endif
+}
+
+XInflateStream::XInflateStream(XSource *s) {
+  src_ = s;
+  base_ = nullptr;
+  reserved_ = committed_ = 0;
+  tooLarge_ = false;
+  produced_ = 0;
+  finished_ = failed_ = cancelled_ = false;
+  size = (size_t) -1;
+}
+
+XInflateStream::~XInflateStream() {
+  stop();
+  if (base_ != nullptr)
+    munmap(base_, reserved_);
+}
+
+bool XInflateStream::start() {
+  // 只预留地址空间, 不可访问的映射不计入提交的内存. 地址空间受限时
+  // 逐步减小预留的大小.
+  size_t n = XDOC_INFLATE_RESERVE;
+  for (; n >= 64 * XDOC_INFLATE_CHUNK; n /= 2) {
+    void *p = mmap(nullptr, n, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p != MAP_FAILED) {
+      base_ = (char *) p;
+      reserved_ = n;
+      break;
+    }
+  }
+  if (base_ == nullptr)
+    return true;
+
+  data = base_;
+  thread_ = std::thread(&XInflateStream::run, this);
+  return false;
+}
+
+void XInflateStream::stop() {
+  if (!thread_.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    cancelled_ = true;
+  }
+  thread_.join();
+}
+
+bool XInflateStream::commit(size_t need) {
+  // 确保 [0, need) 可写, 提交的大小按倍数增长. 新提交的页面内容为 0,
+  // 因此内容之后的填充字节无需另外写入.
+  if (need <= committed_)
+    return false;
+  if (need > reserved_) {
+    tooLarge_ = true;
+    return true;
+  }
+
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t n = committed_ * 2;
+  if (n < need) n = need;
+  n = (n + page - 1) / page * page;
+  if (n > reserved_) n = reserved_;
+
+  if (mprotect(base_ + committed_, n - committed_,
+               PROT_READ | PROT_WRITE) != 0)
+    return true;
+  committed_ = n;
+  return false;
+}
+
+void XInflateStream::run() {
+  size_t pos = 0;
+  bool   failed = false;
+
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      if (cancelled_) break;
+    }
+
+    if (commit(pos + XDOC_INFLATE_CHUNK + BUFFER_PADDING)) {
+      failed = true;
+      break;
+    }
+
+    size_t rn = src_->read(base_ + pos, XDOC_INFLATE_CHUNK);
+    if (rn == 0) {
+      failed = src_->failed;
+      break;
+    }
+    pos += rn;
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    produced_ = pos;
+    cond_.notify_all();
+  }
+
+  std::lock_guard<std::mutex> lk(mutex_);
+  produced_ = pos;
+  finished_ = true;
+  failed_ = failed;
+  cond_.notify_all();
+}
+
+bool XInflateStream::wait(size_t have, size_t *arrived) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  cond_.wait(lk, [this, have] { return produced_ > have || finished_; });
+  *arrived = produced_;
+  // 长度只在解析线程中更新, 解析器看到的 size 不会被并发修改.
+  if (finished_)
+    size = produced_;
+  return finished_ && failed_;
+}
@@ -0,0 +1,147 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_COMPRESS_H
+#define LIBXDOC_COMPRESS_H
+
+// 压缩输入的内部声明: 按魔数识别格式, 解压为 XSource, 以及在后台线程
+// 中解压, 供解析器边解压边解析的 XStream.
+
+#include "source.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+enum XCompression {
+  xCompressNone,
+  xCompressGzip,
+  xCompressZstd,
+};
+
+///@brief 按开头的魔数识别压缩格式.
+XCompression XDetectCompression(const char *data, size_t len);
+
+///@brief 预先读出开头的几个字节用于识别格式, 之后的读取原样交还,
+/// 每次读取都尽量读满.
+struct XPeekSource : XSource {
+  XSource *src;
+  char     head[4];
+  size_t   pos;
+  size_t   len;
+
+  XPeekSource(XSource *s) {
+    src = s;
+    pos = len = 0;
+    while (len < sizeof(head)) {
+      size_t rn = src->read(head + len, sizeof(head) - len);
+      if (rn == 0) break;
+      len += rn;
+    }
+    failed = src->failed;
+  }
+
+  size_t read(char *buf, size_t n) override {
+    size_t got = 0;
+    if (pos < len) {
+      got = n < len - pos ? n : len - pos;
+      memcpy(buf, head + pos, got);
+      pos += got;
+    }
+    // 与其他 XSource 一样尽量读满 n 个字节, 否则调用者拿到的第一块
+    // 只有开头的几个字节, 无法从中识别编码声明.
+    while (got < n) {
+      size_t rn = src->read(buf + got, n - got);
+      if (rn == 0) break;
+      got += rn;
+    }
+    failed = src->failed;
+    return got;
+  }
+
+  size_t sizeHint() override {
+    size_t hint = src->sizeHint();
+    return hint == 0 ? 0 : hint + len - pos;
+  }
+};
+
+// 每次从压缩输入读取的块大小.
+#define XDOC_INFLATE_INPUT (256 * 1024)
+
+///@brief 读取时解压的输入, 支持多个首尾相接的 gzip 成员或 zstd 帧.
+/// 解压出错时设置 failed 与 corrupt, 读取出错时只设置 failed.
+struct XInflateSource : XSource {
+  XSource     *src;
+  XCompression comp;
+  bool         supported; // 编译时未启用对应的格式时为 false.
+  bool         corrupt;
+
+  XInflateSource(XSource *s, XCompression c);
+  ~XInflateSource();
+
+  XInflateSource(const XInflateSource&) = delete;
+  XInflateSource& operator = (const XInflateSource&) = delete;
+
+  ///@brief 尽量读满 n 个字节, 返回 0 表示已经结束或出错.
+  size_t read(char *buf, size_t n) override;
+
+private:
+  bool refill();
+  size_t inflateGzip(char *buf, size_t n);
+  size_t inflateZstd(char *buf, size_t n);
+
+  void  *ctx_;
+  char  *in_;
+  size_t inPos_;
+  size_t inLen_;
+  bool   inEnd_;
+  bool   done_;
+  size_t hint_; // zstd 上一次返回的提示, 为 0 时恰好在帧的边界上.
+};
+
+// 解压线程每次交给解析器的内容大小.
+#define XDOC_INFLATE_CHUNK (1024 * 1024)
+
+///@brief 在后台线程中解压 src 的 XStream. 解压结果写入一段预留的连续
+/// 地址空间, 按需提交内存, 因此地址不变且无需事先知道解压后的长度.
+/// 全部解压之前 size 为 npos.
+struct XInflateStream : XStream {
+  XInflateStream(XSource *s);
+  ///@brief 通知解压线程停止并等待其结束.
+  ~XInflateStream();
+
+  XInflateStream(const XInflateStream&) = delete;
+  XInflateStream& operator = (const XInflateStream&) = delete;
+
+  ///@brief 预留地址空间并启动解压线程, 失败时返回 true.
+  bool start();
+  bool wait(size_t have, size_t *arrived) override;
+
+  ///@brief 通知解压线程停止并等待其结束, 之后才能读取 tooLarge() 与
+  /// 解压来源的状态.
+  void stop();
+
+  ///@brief 解压后的内容超出了预留的地址空间.
+  bool tooLarge() const { return tooLarge_; }
+
+private:
+  void run();
+  bool commit(size_t need);
+
+  XSource *src_;
+  char    *base_;
+  size_t   reserved_;
+  size_t   committed_;
+  bool     tooLarge_;
+
+  std::mutex              mutex_;
+  std::condition_variable cond_;
+  std::thread             thread_;
+  size_t                  produced_;
+  bool                    finished_;
+  bool                    failed_;
+  bool                    cancelled_;
+};
+
+#endif //LIBXDOC_COMPRESS_H
@@ -3,62 +3,128 @@
 //
 
 #include "document.h"
+#include "compress.h"
+#include "encoding.h"
+#include "parser.h"
+#include "source.h"
+#include "writer.h"
 
+#include <algorithm>
 #include <memory.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-typedef const char *ContentPtr;
+// 读取文件时每次处理的块大小.
+#define XDOC_BLOCK_SIZE (64 * 1024)
 
-struct XParser {
-  ContentPtr curr;
-  ContentPtr end;
-
-  bool loadComments;
-
-  XDocument *doc;
-
-  bool parse();
-  bool parseProlog();
-  bool parseElement(XElement *ele);
-  bool parseElementAttrs(XElement *ele);
-  bool parseElementChildren(XElement *ele);
-
-  bool parseComment(XElement *parent);
-  bool parseText(XElement *parent);
-
-  bool SkipBlank();
-  bool MatchName(ContentPtr& b, ContentPtr& e);
-  bool MatchNameStartChar();
-  bool MatchNameChar();
-  bool MatchRefVal(ContentPtr& b, ContentPtr& e);
-
-  bool IsEnd();
-
-  bool DecodeUTF8(uint32_t *unicode);
-};
+// 解析与重新编号时相邻的文档顺序编号之间的间隔.
+#define XDOC_ORDER_GAP ((uint64_t) 1 << 24)
 
 bool XParser::parse() {
   if (parseProlog())
     return true;
 
-  if (SkipBlank())
+  if (SkipMisc())
     return true;
 
-  XElement element;
-  if (parseElement(&element))
+  XElement *root = doc->newElement();
+  if (parseElement(root)) {
+    doc->recycle(root);
     return true;
+  }
 
-  doc->setRoot(std::move(element));
+  doc->root_ = root;
   return false;
 }
 
 bool XParser::parseProlog() {
-  return false; // <?xml version="1.0" encoding="UTF-32"?>
+  // XMLDecl ::= '<?xml' VersionInfo EncodingDecl? SDDecl? S? '?>'
+  if (!Avail(6) || memcmp(curr, "<?xml", 5) != 0)
+    return false;
+  // 以 <?xml 开头的其他处理指令(如 <?xml-stylesheet)不是文档头.
+  if (curr[5] != 0x20 && curr[5] != 0x9 && curr[5] != 0xD && curr[5] != 0xA)
+    return false;
+
+  ContentPtr nbeg, nend, vbeg, vend;
+  curr += 5;
+
+  while (true) {
+    if (SkipBlank()) return true;
+
+    if (*curr == '?') {
+      curr++;
+      if (IsEnd() || *curr != '>') {
+        // TODO: 文档头应该以 '?>' 结尾.
+        return true;
+      }
+      curr++;
+      doc->hend_ = curr - begin;
+      return false;
+    }
+
+    if (MatchName(nbeg, nend)) return true;
+    if (SkipBlank()) return true;
+    if (*(curr++) != '=') return true;
+    if (SkipBlank()) return true;
+    if (MatchRefVal(vbeg, vend)) return true;
+
+    std::string *field;
+    size_t len = nend - nbeg;
+    if (len == 7 && memcmp(nbeg, "version", 7) == 0) {
+      field = &doc->hversion_;
+    } else if (len == 8 && memcmp(nbeg, "encoding", 8) == 0) {
+      field = &doc->hencoding_;
+    } else if (len == 10 && memcmp(nbeg, "standalone", 10) == 0) {
+      field = &doc->hstandalone_;
+    } else {
+      // TODO: 文档头中不允许出现其他属性.
+      return true;
+    }
+    field->assign(vbeg, vend - vbeg);
+  }
+}
+
+bool XParser::SkipMisc() {
+  // 跳过根元素之前的注释, 处理指令与文档类型声明, 保留源内容时它们
+  // 会随文档头一起原样保存.
+  // Misc ::= Comment | PI | S
+  while (true) {
+    if (SkipBlank()) return true;
+
+    if (Avail(4) && memcmp(curr, "<!--", 4) == 0) {
+      curr += 4;
+      if (SkipTo("-->", 3)) return true;
+    } else if (Avail(2) && memcmp(curr, "<?", 2) == 0) {
+      if (SkipTo("?>", 2)) return true;
+    } else if (Avail(9) && memcmp(curr, "<!DOCTYPE", 9) == 0) {
+      // 内部子集 [...] 中可能出现 '>'.
+      size_t depth = 0;
+      for (curr += 9; ; curr++) {
+        if (IsEnd()) return true;
+        if (*curr == '"' || *curr == '\'') {
+          char quote = *(curr++);
+          if (FindChar(quote)) return true;
+        } else if (*curr == '[') {
+          depth++;
+        } else if (*curr == ']') {
+          if (depth > 0) depth--;
+        } else if (*curr == '>' && depth == 0) {
+          curr++;
+          break;
+        }
+      }
+    } else {
+      return false;
+    }
+  }
 }
 
 bool XParser::parseElement(XElement *ele) {
   ContentPtr nbeg, nend;
 
+  ele->node.srcBeg = curr - begin;
   if (*(curr++) != '<') {
     return true;
   }
@@ -68,15 +134,30 @@ bool XParser::parseElement(XElement *ele) {
   // TODO: 如果要获得更准确的错误反馈，
   //  这里还需要判断名字是否以 '空白' 或 '>' 结尾.
 
-  ele->setName(nbeg, nend - nbeg);
+  // 解析得到的节点不标记为修改过, 直接设置文本.
+  ele->node.txt.assign(nbeg, nend - nbeg);
+
+  return parseElementBody(ele);
+}
+
+bool XParser::parseElementBody(XElement *ele) {
+  // 元素上声明的前缀只在元素内部有效.
+  size_t scope = nsScope.size();
+  ele->node.pre = order += XDOC_ORDER_GAP;
 
   if (SkipBlank()) return true;
   if (parseElementAttrs(ele)) return true;
+  if (opts->namespaces && ResolveNs(ele)) return true;
 
   // not has children node.
   if (*curr == '/') {
-    if (*(++curr) == '>') {
+    curr++;
+    if (IsEnd()) return true;
+    if (*curr == '>') {
       curr++;
+      ele->srcTagEnd = ele->srcCloseBeg = ele->node.srcEnd = curr - begin;
+      ele->node.post = order += XDOC_ORDER_GAP;
+      nsScope.resize(scope);
       return false;
     } else {
       // TODO: 无效的符号.
@@ -87,14 +168,18 @@ bool XParser::parseElement(XElement *ele) {
   assert(*curr == '>');
 
   curr++;
+  ele->srcTagEnd = curr - begin;
 
-  return parseElementChildren(ele);
+  if (parseElementChildren(ele)) return true;
+  ele->node.post = order += XDOC_ORDER_GAP;
+  nsScope.resize(scope);
+  return false;
 }
 
 bool XParser::parseElementAttrs(XElement *ele) {
   ContentPtr nbeg, nend;
 
-  while (*curr != '>' && *curr != '/' && curr != end) {
+  while (!IsEnd() && *curr != '>' && *curr != '/') {
     if (MatchName(nbeg, nend)) return true;
     if (SkipBlank()) return true;
     
@@ -103,12 +188,16 @@ bool XParser::parseElementAttrs(XElement *ele) {
       return true;
     }
 
-    XAttribute *attr = ele->addAttr(nbeg, (int) (nend - nbeg));
+    XAttribute *attr = addAttr(ele, nbeg, nend);
     
     if (SkipBlank()) return true;
     if (MatchRefVal(nbeg, nend)) return true;
 
-    attr->val.assign(nbeg, (int) (nend - nbeg));
+    // 重复的属性不会覆盖首次出现的值, 也不会重复声明命名空间.
+    if (attr != nullptr) {
+      attr->val.assign(nbeg, nend - nbeg);
+      if (opts->namespaces && DeclareNs(attr)) return true;
+    }
 
     nbeg = curr;
     if (SkipBlank()) return true;
@@ -122,12 +211,20 @@ bool XParser::parseElementAttrs(XElement *ele) {
 }
 
 bool XParser::parseElementChildren(XElement *ele) {
-  ContentPtr nbeg, nend;
-  nbeg = curr;
+  ContentPtr nbeg, nend, tbeg;
   while (true) {
+    tbeg = curr;
     if (SkipBlank()) return true;
 
     if (*(curr++) == '<') {
+      size_t tagBeg = curr - 1 - begin;
+
+      // 标签之间仅包含空白的文本.
+      if (!opts->dropBlankText && tbeg != curr - 1)
+        addText(ele, tbeg, curr - 1);
+
+      if (IsEnd()) return true;
+
       if (*curr == '/') { // 结束标签
         curr++;
         if (MatchName(nbeg, nend)) return true;
@@ -136,49 +233,212 @@ bool XParser::parseElementChildren(XElement *ele) {
           return true;
         }
 
-        SkipBlank();
+        if (SkipBlank()) return true;
 
         if (*(curr)++ != '>') {
           //TODO: 结束标签不能包含除标签名以外的任何信息.
           return true;
         }
 
+        ele->srcCloseBeg = tagBeg;
+        ele->node.srcEnd = curr - begin;
         return false;
-      } else if (memcmp(curr, "!--", 3) == 0) { // 注释
+      } else if (Avail(3) && memcmp(curr, "!--", 3) == 0) { // 注释
         curr += 3;
         if (parseComment(ele)) return true;
-        nbeg = curr;
       } else { //
-        XElement *child = ele->addChildElement();
-        curr--;
-        if (parseElement(child)) return true;
-        nbeg = curr;
+        if (MatchName(nbeg, nend)) return true;
+        // 被过滤的子树直接跳过, 不会为其分配任何节点.
+        if (IsSkipped(nbeg, nend)) {
+          if (SkipElement()) return true;
+          continue;
+        }
+
+        XElement *child = addElement(ele);
+        child->node.txt.assign(nbeg, nend - nbeg);
+        child->node.srcBeg = tagBeg;
+        if (parseElementBody(child)) return true;
       }
-     } else {
-      curr = nbeg;
+    } else {
+      curr = tbeg;
       if (parseText(ele)) return true;
     }
   }
 }
 
-bool XParser::parseComment(XElement *parent) {
-  ContentPtr nbeg, nend;
-  nbeg = curr;
+XElement *XParser::addElement(XElement *parent) {
+  XElement *ele = doc->newElement();
+  llist_add(&parent->children.llnode, &ele->node.llnode);
+  ele->node.owner = parent;
+  ele->node.depth = parent->node.depth + 1;
+  return ele;
+}
 
-  while (++curr != end) {
-    if (*curr == '-' && memcmp(curr, "-->", 3) == 0) {
-      nend = curr;
-      break;
+XNode *XParser::addNode(XElement *parent, XNodeType type) {
+  XNode *node = doc->newNode(type);
+  llist_add(&parent->children.llnode, &node->llnode);
+  node->owner = parent;
+  node->depth = parent->node.depth + 1;
+  node->pre = node->post = order += XDOC_ORDER_GAP;
+  return node;
+}
+
+XAttribute *XParser::addAttr(XElement *ele, ContentPtr b, ContentPtr e) {
+  XAttribute *attr = doc->newAttr();
+  attr->key.assign(b, e - b);
+  XAttribute *dup = (XAttribute *) rbtree_insert(&ele->attrs, &attr->rbnode);
+  if (dup != nullptr) {
+    // TODO: 同一元素中不允许出现重复的属性, 目前忽略之后出现的, 保留
+    // 首次出现的值.
+    doc->recycle(attr);
+    return nullptr;
+  }
+  return attr;
+}
+
+bool XParser::DeclareNs(XAttribute *attr) {
+  // 只在解析属性时调用, 此时前缀的作用域从所在元素开始.
+  const std::string& key = attr->key;
+  if (key.compare(0, 5, "xmlns") != 0)
+    return false;
+
+  XNsBinding binding;
+  if (key.length() == 5) {
+    binding.prefix = key.c_str() + 5;
+    binding.len = 0;
+  } else if (key[5] == ':') {
+    binding.prefix = key.c_str() + 6;
+    binding.len = key.length() - 6;
+    // Namespaces in XML 1.0 不允许取消带前缀的绑定.
+    if (binding.len == 0 || attr->val.empty()) {
+      doc->setError(xErrParse, "invalid namespace declaration");
+      return true;
     }
+  } else {
+    return false;
   }
 
-  curr += 3;
-  
-  if (IsEnd()) return true;
+  // xmlns="" 取消默认命名空间.
+  binding.ns = attr->val.empty() ? XNS_NONE : doc->internNamespace(attr->val);
+  nsScope.push_back(binding);
+  return false;
+}
+
+// 带前缀的属性不超过此数量时两两比较扩展名, 否则排序后比较相邻的.
+#define XDOC_NS_DUP_LINEAR (16)
+
+static bool NsAttrLess(const XAttribute *a, const XAttribute *b) {
+  if (a->nsId != b->nsId)
+    return a->nsId < b->nsId;
+  return strcmp(a->localName(), b->localName()) < 0;
+}
+
+static bool NsAttrEqual(const XAttribute *a, const XAttribute *b) {
+  return a->nsId == b->nsId && strcmp(a->localName(), b->localName()) == 0;
+}
+
+bool XParser::ResolveNs(XElement *ele) {
+  if (ResolveName(ele->node.txt, false, &ele->nsId, &ele->localPos))
+    return true;
+
+  // 前缀不同的两个属性也可能有相同的扩展名(命名空间与本地名),
+  // Namespaces in XML 1.0 §6.3 不允许这种情况. 没有前缀的属性
+  // 已经由属性名本身保证不重复, 只需检查带前缀的.
+  nsAttrs.clear();
+
+  rbnode_t *rbn = rbt_min(ele->attrs.root);
+  while (rbn) {
+    XAttribute *attr = (XAttribute *) rbn;
+    if (ResolveName(attr->key, true, &attr->nsId, &attr->localPos))
+      return true;
+    if (attr->nsId != XNS_NONE)
+      nsAttrs.push_back(attr);
+    rbn = rbt_next(rbn);
+  }
 
-  if (loadComments) {
-    XNode *node = parent->addChildComment();
-    node->setTxt(nbeg, (int) (nend - nbeg));
+  bool dup = false;
+  if (nsAttrs.size() <= XDOC_NS_DUP_LINEAR) {
+    for (size_t i = 1; i < nsAttrs.size() && !dup; i++) {
+      for (size_t j = 0; j < i && !dup; j++)
+        dup = NsAttrEqual(nsAttrs[i], nsAttrs[j]);
+    }
+  } else {
+    std::sort(nsAttrs.begin(), nsAttrs.end(), NsAttrLess);
+    for (size_t i = 1; i < nsAttrs.size() && !dup; i++)
+      dup = NsAttrEqual(nsAttrs[i], nsAttrs[i - 1]);
+  }
+
+  if (dup) {
+    doc->setError(xErrParse, "duplicate attribute");
+    return true;
+  }
+  return false;
+}
+
+bool XParser::ResolveName(const std::string& name, bool attr,
+                          XNsId *ns, size_t *local) {
+  const char *s = name.c_str();
+  const char *colon = (const char *) memchr(s, ':', name.length());
+
+  if (colon == nullptr) {
+    // 没有前缀的属性不属于任何命名空间, 也不受默认命名空间影响.
+    *local = 0;
+    if (attr)
+      *ns = name == "xmlns" ? XNS_XMLNS : XNS_NONE;
+    else
+      *ns = LookupNs(s, 0);
+    return false;
+  }
+
+  size_t len = colon - s;
+  *local = len + 1;
+  if (len == 0 || *local == name.length()) {
+    doc->setError(xErrParse, "invalid qualified name");
+    return true;
+  }
+
+  if (len == 5 && memcmp(s, "xmlns", 5) == 0) {
+    *ns = XNS_XMLNS;
+  } else if (len == 3 && memcmp(s, "xml", 3) == 0) {
+    *ns = XNS_XML;
+  } else {
+    *ns = LookupNs(s, len);
+    if (*ns == XNS_UNKNOWN) {
+      doc->setError(xErrParse, "undeclared namespace prefix");
+      return true;
+    }
+  }
+
+  // 元素不能使用 xmlns 前缀.
+  if (!attr && *ns == XNS_XMLNS) {
+    doc->setError(xErrParse, "invalid qualified name");
+    return true;
+  }
+  return false;
+}
+
+XNsId XParser::LookupNs(const char *prefix, size_t len) {
+  // 由内向外查找, 内层的声明覆盖外层.
+  for (size_t i = nsScope.size(); i > 0; i--) {
+    const XNsBinding& b = nsScope[i - 1];
+    if (b.len == len && memcmp(b.prefix, prefix, len) == 0)
+      return b.ns;
+  }
+  return len == 0 ? XNS_NONE : XNS_UNKNOWN;
+}
+
+bool XParser::parseComment(XElement *parent) {
+  ContentPtr nbeg, nend;
+  nbeg = curr;
+
+  if (SkipTo("-->", 3)) return true;
+  nend = curr - 3;
+
+  if (opts->loadComments) {
+    XNode *node = addNode(parent, xNodeTypeComment);
+    node->txt.assign(nbeg, nend - nbeg);
+    node->srcBeg = nbeg - 4 - begin;
+    node->srcEnd = curr - begin;
   }
 
   return false;
@@ -189,29 +449,142 @@ bool XParser::parseText(XElement *parent) {
   nbeg = curr;
 
   // TODO: 是否需要检验文本内容合法?.
-  while (++curr != end) {
-    // 解析至出现新的标签起始符,判定为文本结束.
-    if (*curr == '<') {
-      nend = curr;
-      break;
+  // 解析至出现新的标签起始符,判定为文本结束.
+  if (FindChar('<')) return true;
+  nend = curr;
+
+  addText(parent, nbeg, nend);
+
+  return false;
+}
+
+void XParser::addText(XElement *parent, ContentPtr b, ContentPtr e) {
+  // 源内容的范围包含被去除的空白.
+  size_t srcBeg = b - begin, srcEnd = e - begin;
+
+  if (opts->trimText) {
+    while (b < e && IS_BLANK(*b))       b++;
+    while (b < e && IS_BLANK(*(e - 1))) e--;
+    if (b == e)
+      return;
+  }
+
+  XNode *node = addNode(parent, xNodeTypeText);
+  node->txt.assign(b, e - b);
+  node->srcBeg = srcBeg;
+  node->srcEnd = srcEnd;
+}
+
+bool XParser::IsSkipped(ContentPtr b, ContentPtr e) {
+  const std::vector<std::string>& names = opts->skipElements;
+  size_t len = e - b;
+  for (size_t i = 0; i < names.size(); i++) {
+    if (names[i].length() == len && memcmp(names[i].c_str(), b, len) == 0)
+      return true;
+  }
+  return false;
+}
+
+bool XParser::SkipElement() {
+  // curr 位于开始标签的名字之后. 跳过该元素的剩余部分, 期间只统计
+  // 标签的嵌套深度, 不解析名字与属性, 也不检查结束标签是否匹配.
+  size_t depth = 1;
+  bool   inTag = true;
+
+  while (true) {
+    if (inTag) {
+      bool closed;
+      if (SkipTag(&closed)) return true;
+      if (closed) depth--;
+      inTag = false;
+      if (depth == 0)
+        return false;
+      continue;
+    }
+
+    if (FindChar('<')) return true;
+    curr++;
+    if (IsEnd()) return true;
+
+    if (*curr == '/') {
+      depth--;
+      if (SkipTo(">", 1)) return true;
+      if (depth == 0)
+        return false;
+    } else if (*curr == '!') {
+      if (Avail(3) && memcmp(curr, "!--", 3) == 0) {
+        if (SkipTo("-->", 3)) return true;
+      } else if (Avail(8) && memcmp(curr, "![CDATA[", 8) == 0) {
+        if (SkipTo("]]>", 3)) return true;
+      } else {
+        if (SkipTo(">", 1)) return true;
+      }
+    } else if (*curr == '?') {
+      if (SkipTo("?>", 2)) return true;
+    } else {
+      depth++;
+      inTag = true;
     }
   }
+}
 
-  if (IsEnd()) return true;
+bool XParser::SkipTag(bool *closed) {
+  // 跳过开始标签的剩余部分直到 '>' 之后, 属性值中的 '>' 需要跳过.
+  // closed 表示标签是否以 "/>" 自行结束.
+  while (true) {
+    while (curr < end && *curr != '>' && *curr != '"' && *curr != '\'')
+      curr++;
+    if (IsEnd()) return true;
+    if (*curr == '>')
+      break;
 
-  XNode *node = parent->addChildText();
-  node->setTxt(nbeg, (int) (nend - nbeg));
+    char quote = *(curr++);
+    if (FindChar(quote)) return true;
+    curr++;
+  }
 
+  *closed = *(curr - 1) == '/';
+  curr++;
   return false;
 }
 
+bool XParser::SkipTo(const char *seq, size_t len) {
+  // 将 curr 移动到 seq 之后.
+  while (true) {
+    if (FindChar(seq[0])) return true;
+    if (!Avail(len)) {
+      curr = end;
+      return true;
+    }
+    if (memcmp(curr, seq, len) == 0) {
+      curr += len;
+      return false;
+    }
+    curr++;
+  }
+}
+
+bool XParser::FindChar(char ch) {
+  // 将 curr 移动到下一个 ch 处.
+  while (true) {
+    ContentPtr p = (ContentPtr) memchr(curr, ch, end - curr);
+    if (p != nullptr) {
+      curr = p;
+      return false;
+    }
+    curr = end;
+    if (!More()) return true;
+  }
+}
+
 bool XParser::SkipBlank() {
   // 跳过空白段，包括一个或多个空格字符，回车，换行和制表符
   // S ::= (#x20 | #x9 | #xD | #xA)+
-  while ((curr != end)
-      && (*curr == 0x20 || *curr == 0x9 || *curr == 0xD || *curr == 0xA)) {
-    curr++;
-  }
+  do {
+    while ((curr != end) && IS_BLANK(*curr)) {
+      curr++;
+    }
+  } while (curr == end && More());
   return IsEnd();
 }
 
@@ -225,11 +598,14 @@ bool XParser::SkipBlank() {
 )
 
 bool XParser::MatchName(ContentPtr& b, ContentPtr& e) {
+  if (IsEnd()) return true;
+
   b = curr;
 
   if (MatchNameStartChar()) return true;
+  curr++;
 
-  while (curr != end) {
+  while (!IsEnd()) {
     if (MatchNameChar())
       break;
 
@@ -276,6 +652,7 @@ bool XParser::MatchNameChar() {
   //              [#x0300-#x036F] | [#x203F-#x2040]
   if (!IS_LETTER(*curr) && !IS_NUMBER(*curr) && *curr != ':'
    && *curr != '_' && *curr != '-' && *curr != '.') {
+    ContentPtr start = curr;
     uint32_t uc;
     if (DecodeUTF8(&uc)) return true;
     if (!((uc == 0xB7)
@@ -292,6 +669,7 @@ bool XParser::MatchNameChar() {
           || (uc >= 0x10000 && uc <= 0xEFFFF)
           || (uc >= 0x0300 && uc <= 0x036F)
           || (uc >= 0x203F && uc <= 0x2040))) {
+      curr = start;
       return true;
     }
   }
@@ -308,8 +686,7 @@ bool XParser::MatchRefVal(ContentPtr& b, ContentPtr& e) {
 
   b = ++curr;
 
-  while (*curr != refChar && curr != end)
-    curr++;
+  if (FindChar(refChar)) return true;
 
   e = curr++;
 
@@ -317,50 +694,92 @@ bool XParser::MatchRefVal(ContentPtr& b, ContentPtr& e) {
 }
 
 bool XParser::DecodeUTF8(uint32_t *unicode) {
-  unsigned char *p = (unsigned char *) curr;
-  if (*p < 0x7F) {
-    *unicode = (uint32_t) *p;
+  // 解码 curr 处的一个字符, 成功后 curr 指向该字符的最后一个字节.
+  // 非法的首字节, 后续字节, 过长编码, 代理项以及被 end 截断的
+  // 字符均视为错误, 且不移动 curr.
+  const unsigned char *p = (const unsigned char *) curr;
+  if (p[0] < 0x80) {
+    *unicode = (uint32_t) p[0];
     return false;
   }
 
+  static const uint32_t minimum[] = { 0, 0, 0x80, 0x800, 0x10000 };
+  uint32_t uc;
+  size_t   n;
   if ((p[0] & 0xE0) == 0xC0) {
-    *unicode = (((uint32_t)p[0] & 0x7F) << 6) |
-               (((uint32_t)p[1] & 0x3F));
-    curr += 1;
+    uc = p[0] & 0x1F;
+    n  = 2;
   } else if ((p[0] & 0xF0) == 0xE0) {
-    *unicode = (((uint32_t)p[0]  & 0x0F) << 12) |
-               (((uint32_t)p[1]  & 0x3F) << 6)  |
-               (((uint32_t)p[2]) & 0x3F);
-    curr += 2;
+    uc = p[0] & 0x0F;
+    n  = 3;
+  } else if ((p[0] & 0xF8) == 0xF0) {
+    uc = p[0] & 0x07;
+    n  = 4;
   } else {
-    *unicode = (((uint32_t)p[0] & 0x07) << 18) |
-               (((uint32_t)p[1] & 0x3F) << 12) |
-               (((uint32_t)p[2] & 0x3F) << 6)  |
-               (((uint32_t)p[3] & 0x3F));
-    curr += 3;
+    return true;
   }
 
-  return IsEnd();
-}
+  if (!Avail(n))
+    return true;
 
+  for (size_t i = 1; i < n; i++) {
+    if ((p[i] & 0xC0) != 0x80)
+      return true;
+    uc = (uc << 6) | (p[i] & 0x3F);
+  }
+
+  if (uc < minimum[n] || uc > 0x10FFFF || (uc >= 0xD800 && uc <= 0xDFFF))
+    return true;
+
+  *unicode = uc;
+  curr += n - 1;
+  return false;
+}
 
 bool XParser::IsEnd() {
   // Maybe out the end pointer.
-  if (curr >= end)
-    //TODO: set error.
-    return true;
+  while (curr >= end) {
+    if (!More())
+      //TODO: set error.
+      return true;
+  }
 
   return false;
 }
 
-void XNode::setTxt(const char *t, int len) {
-  if (len == -1)
-    len = (int) strlen(t);
+bool XParser::More() {
+  return feed != nullptr && feed->more(&end);
+}
+
+bool XParser::Avail(size_t n) {
+  while ((size_t) (end - curr) < n) {
+    if (!More()) return false;
+  }
+  return true;
+}
+
+void XNode::setTxt(const char *t, size_t len) {
+  if (len == std::string::npos)
+    len = strlen(t);
   txt.assign(t, len);
+  markDirty();
 }
 
 void XNode::setTxt(const std::string& t) {
-  setTxt(t.c_str(), (int) t.length());
+  setTxt(t.c_str(), t.length());
+}
+
+// 标记 ele 及其祖先的子孙节点被修改过, 遇到已经标记的祖先即可停止.
+static void MarkChildDirty(XElement *ele) {
+  while (ele != nullptr && !ele->node.childDirty) {
+    ele->node.childDirty = true;
+    ele = ele->node.owner;
+  }
+}
+
+void XNode::markDirty() {
+  dirty = true;
+  MarkChildDirty(owner);
 }
 
 XNode *XNode::prev() {
@@ -382,6 +801,9 @@ XElement::XElement()
   });
 
   llist_init(&children.llnode);
+  srcTagEnd = srcCloseBeg = 0;
+  nsId = XNS_NONE;
+  localPos = 0;
 }
 
 void deleteRBNode(XAttribute *attr) {
@@ -406,15 +828,25 @@ XElement::~XElement() {
   }
 }
 
-XAttribute *XElement::addAttr(const char *key, int len) {
+XAttribute *XElement::addAttr(const char *key, size_t len) {
+  if (len == std::string::npos)
+    len = strlen(key);
+
   XAttribute *attr = new XAttribute();
   attr->key.assign(key, len);
-  rbtree_insert(&attrs, &attr->rbnode);
+  XAttribute *dup = (XAttribute *) rbtree_insert(&attrs, &attr->rbnode);
+  if (dup != nullptr) {
+    delete attr;
+    attr = dup;
+  }
+
+  // 调用者通常紧接着修改属性值.
+  node.markDirty();
   return attr;
 }
 
 XAttribute *XElement::addAttr(const std::string& key) {
-  return addAttr(key.c_str(), (int) key.length());
+  return addAttr(key.c_str(), key.length());
 }
 
 XAttribute *XElement::operator [] (const char *key) const {
@@ -428,7 +860,7 @@ XAttribute *XElement::operator [] (const std::string& key) const {
 XAttribute *XElement::findAttr(const char *key) const {
   XAttribute *rbn = (XAttribute *) attrs.root;
   while (rbn) {
-    int cmp = strcmp(rbn->key.c_str(), key);
+    int cmp = strcmp(key, rbn->key.c_str());
     if (cmp < 0)      rbn = (XAttribute *) RBT_LEFT(&rbn->rbnode);
     else if (cmp > 0) rbn = (XAttribute *) RBT_RIGHT(&rbn->rbnode);
     else return rbn;
@@ -439,24 +871,130 @@ XAttribute *XElement::findAttr(const std::string& key) const {
   return findAttr(key.c_str());
 }
 
+XAttribute *XElement::findAttr(XNsId ns, const char *local) const {
+  // 属性按完整的名字排序, 不同的前缀可能对应同一命名空间, 只能逐个比较.
+  rbnode_t *rbn = rbt_min(attrs.root);
+  while (rbn) {
+    XAttribute *attr = (XAttribute *) rbn;
+    if (attr->nsId == ns && strcmp(attr->localName(), local) == 0)
+      return attr;
+    rbn = rbt_next(rbn);
+  }
+  return nullptr;
+}
+
+// 为刚添加到 parent 末尾的节点从 parent 剩余的间隔中分配编号:
+// 元素占用剩余部分的前一半, 后一半留给之后的同级节点. 间隔不够或
+// 前面的节点没有编号时不分配, 等查询时整棵树重新编号.
+static void AllocOrder(XElement *parent, XNode *node) {
+  XNode *prev = node->prev();
+  uint64_t last = prev == &parent->children ? parent->node.pre : prev->post;
+  uint64_t room = parent->node.post - last;
+
+  node->depth = parent->node.depth + 1;
+  if (parent->node.pre == 0 || last == 0)
+    return;
+
+  if (node->type != xNodeTypeElement) {
+    if (room >= 2)
+      node->pre = node->post = last + 1;
+  } else if (room >= 4) {
+    node->pre = last + 1;
+    node->post = last + room / 2;
+  }
+}
+
 XComments *XElement::addChildComment() {
   XComments *comment = new XNode(xNodeTypeComment);
   llist_add(&children.llnode, &comment->llnode);
+  comment->owner = this;
+  AllocOrder(this, comment);
+  MarkChildDirty(this);
   return comment;
 }
 
 XText *XElement::addChildText() {
   XText *text = new XNode(xNodeTypeText);
   llist_add(&children.llnode, &text->llnode);
+  text->owner = this;
+  AllocOrder(this, text);
+  MarkChildDirty(this);
   return text;
 }
 
 XElement *XElement::addChildElement() {
   XElement *ele = new XElement();
   llist_add(&children.llnode, &ele->node.llnode);
+  ele->node.owner = this;
+  AllocOrder(this, &ele->node);
+  MarkChildDirty(this);
   return ele;
 }
 
+static uint64_t Renumber(XElement *ele, uint64_t order) {
+  ele->node.pre = order += XDOC_ORDER_GAP;
+  for (XNode *n = ele->children.next(); n != &ele->children; n = n->next()) {
+    if (n->type == xNodeTypeElement) {
+      order = Renumber((XElement *) n, order);
+    } else {
+      n->pre = n->post = order += XDOC_ORDER_GAP;
+    }
+  }
+  ele->node.post = order += XDOC_ORDER_GAP;
+  return order;
+}
+
+// 节点没有编号时为其所在的整棵树重新编号. 有编号的节点之间的顺序
+// 总是正确的, 因此只需检查参与比较的节点.
+static void EnsureOrder(XNode *node) {
+  if (node->pre != 0)
+    return;
+
+  XNode *top = node;
+  while (top->owner != nullptr)
+    top = &top->owner->node;
+
+  if (top->type == xNodeTypeElement)
+    Renumber((XElement *) top, 0);
+  else
+    top->pre = top->post = XDOC_ORDER_GAP;
+}
+
+int XNode::compareDocumentOrder(XNode *other) {
+  EnsureOrder(this);
+  EnsureOrder(other);
+  if (pre != other->pre)
+    return pre < other->pre ? -1 : 1;
+  return 0;
+}
+
+bool XElement::isAncestorOf(XNode *n) {
+  EnsureOrder(&node);
+  EnsureOrder(n);
+  return node.pre < n->pre && n->post < node.post;
+}
+
+void XSortDocumentOrder(std::vector<XNode *>& nodes) {
+  for (size_t i = 0; i < nodes.size(); i++)
+    EnsureOrder(nodes[i]);
+
+  std::sort(nodes.begin(), nodes.end(), [](XNode *a, XNode *b) {
+    return a->pre < b->pre;
+  });
+  nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+}
+
+void XSortDocumentOrder(std::vector<XElement *>& elements) {
+  for (size_t i = 0; i < elements.size(); i++)
+    EnsureOrder(&elements[i]->node);
+
+  std::sort(elements.begin(), elements.end(), [](XElement *a, XElement *b) {
+    return a->node.pre < b->node.pre;
+  });
+  elements.erase(std::unique(elements.begin(), elements.end()),
+                 elements.end());
+}
+
 XElement *XElement::first() {
   if (LLIST_EMPTY(&children.llnode))
     return nullptr;
@@ -505,12 +1043,49 @@ XElement *XElement::next() {
   return nullptr;
 }
 
+static bool MatchQName(XElement *ele, XNsId ns, const char *local) {
+  return ele->nsId == ns && strcmp(ele->localName(), local) == 0;
+}
+
+XElement *XElement::child(XNsId ns, const char *local) {
+  XElement *ele = first();
+  while (ele != nullptr && !MatchQName(ele, ns, local))
+    ele = ele->next();
+  return ele;
+}
+
+XElement *XElement::next(XNsId ns, const char *local) {
+  XElement *ele = next();
+  while (ele != nullptr && !MatchQName(ele, ns, local))
+    ele = ele->next();
+  return ele;
+}
+
+// 预定义的命名空间, 下标即为编号.
+static const char *const PredefinedNs[] = {
+  "",
+  "http://www.w3.org/XML/1998/namespace",
+  "http://www.w3.org/2000/xmlns/",
+};
+
+#define XNS_PREDEFINED (sizeof(PredefinedNs) / sizeof(PredefinedNs[0]))
+
 XDocument::XDocument() {
   root_ = nullptr;
+  error_ = xNoErr;
+  erroff_ = 0;
+  hend_ = 0;
+  buffer_init(&source_);
+  nsUris_.assign(PredefinedNs, PredefinedNs + XNS_PREDEFINED);
 }
 
 XDocument::XDocument(const std::string& path) {
   root_ = nullptr;
+  error_ = xNoErr;
+  erroff_ = 0;
+  hend_ = 0;
+  buffer_init(&source_);
+  nsUris_.assign(PredefinedNs, PredefinedNs + XNS_PREDEFINED);
   load(path);
 }
 
@@ -518,48 +1093,759 @@ XDocument::~XDocument() {
   if (root_) {
     delete root_;
   }
+
+  for (size_t i = 0; i < freeElements_.size(); i++)
+    delete freeElements_[i];
+  for (size_t i = 0; i < freeNodes_.size(); i++)
+    delete freeNodes_[i];
+  for (size_t i = 0; i < freeAttrs_.size(); i++)
+    delete freeAttrs_[i];
+
+  buffer_free(&source_);
 }
 
-bool XDocument::load(const std::string& path) {
-  XParser parser;
+// 校验 data 中 [*checked, len) 这段新读入的内容. 块尾被截断的字符
+// 留到下一次再校验, final 为 true 时则直接视为错误.
+static bool ValidateTail(const char *data, size_t len, size_t *checked,
+                         bool final, size_t *pos) {
+  size_t off;
+  if (!XValidateUTF8(data + *checked, len - *checked, &off)) {
+    *checked = len;
+    return false;
+  }
+
+  off += *checked;
+  if (!final && len - off < 4) {
+    *checked = off;
+    return false;
+  }
+
+  *pos = off;
+  return true;
+}
+
+bool XDocument::load(const std::string& path, const XParseOptions& opts) {
+  buffer_t content;
+  buffer_init(&content);
+
+  bool res = loadFile(path, opts, &content);
+
+  buffer_free(&content);
+  return res;
+}
+
+bool XDocument::loadBuffer(const char *data, size_t len,
+                           const XParseOptions& opts) {
+  buffer_t content;
+  buffer_init(&content);
+
+  XMemorySource src(data, len);
+  bool res = load(&src, opts, &content);
+
+  buffer_free(&content);
+  return res;
+}
+
+bool XDocument::loadFd(int fd, const XParseOptions& opts) {
+  buffer_t content;
+  buffer_init(&content);
+
+  XFdSource src(fd);
+  bool res = load(&src, opts, &content);
 
-  // load fcontent.
+  buffer_free(&content);
+  return res;
+}
+
+bool XDocument::load(std::istream& in, const XParseOptions& opts) {
+  buffer_t content;
+  buffer_init(&content);
+
+  XIStreamSource src(&in);
+  bool res = load(&src, opts, &content);
+
+  buffer_free(&content);
+  return res;
+}
+
+bool XDocument::loadFile(const std::string& path, const XParseOptions& opts,
+                         buffer_t *content) {
   FILE *fp = fopen(path.c_str(), "rb");
   if (fp == NULL) {
-    //xdcerr(x, xde_badfile, "can't open the xmlfile");
+    clear();
+    setError(xErrBadFile, "can't open the xml file");
     return false;
   }
 
-  fseek(fp, 0, SEEK_END);
-  fpos_t len;
-  fgetpos(fp, &len);
-  char *content = (char *) malloc(len);
-  if (content == NULL) {
-    //xdcerr(x, xde_memory, "no enough memory");
-    fclose(fp);
+  XFileSource src(fp);
+  bool res = load(&src, opts, content);
+  filePath_ = path;
+
+  fclose(fp);
+  return res;
+}
+
+void XDocument::clear() {
+  filePath_.clear();
+  error_ = xNoErr;
+  errtxt_.clear();
+  erroff_ = 0;
+
+  hversion_.clear();
+  hencoding_.clear();
+  hstandalone_.clear();
+  hend_ = 0;
+  source_.len = 0;
+  nsUris_.resize(XNS_PREDEFINED);
+
+  if (root_) {
+    recycle(root_);
+    root_ = nullptr;
+  }
+}
+
+void XDocument::recycle(XAttribute *attr) {
+  freeAttrs_.push_back(attr);
+}
+
+void XDocument::recycle(XElement *ele) {
+  // 回收 ele 本身及其全部属性与子节点.
+  std::vector<XAttribute *>& attrs = freeAttrs_;
+  rbnode_t *rbn = rbt_min(ele->attrs.root);
+  while (rbn) {
+    attrs.push_back((XAttribute *) rbn);
+    rbn = rbt_next(rbn);
+  }
+  ele->attrs.root = NULL;
+
+  for (XNode *n = ele->children.next(); n != &ele->children;) {
+    XNode *tmp = n;
+    n = n->next();
+    if (tmp->type == xNodeTypeElement) {
+      recycle((XElement *) tmp);
+    } else {
+      freeNodes_.push_back(tmp);
+    }
+  }
+  llist_init(&ele->children.llnode);
+
+  freeElements_.push_back(ele);
+}
+
+static void ResetNode(XNode *node) {
+  node->txt.clear();
+  node->owner = nullptr;
+  node->srcBeg = node->srcEnd = 0;
+  node->dirty = node->childDirty = false;
+  node->pre = node->post = 0;
+  node->depth = 0;
+}
+
+XElement *XDocument::newElement() {
+  if (freeElements_.empty())
+    return new XElement();
+
+  XElement *ele = freeElements_.back();
+  freeElements_.pop_back();
+  ResetNode(&ele->node);
+  ele->srcTagEnd = ele->srcCloseBeg = 0;
+  ele->nsId = XNS_NONE;
+  ele->localPos = 0;
+  return ele;
+}
+
+XNode *XDocument::newNode(XNodeType type) {
+  if (freeNodes_.empty())
+    return new XNode(type);
+
+  XNode *node = freeNodes_.back();
+  freeNodes_.pop_back();
+  node->type = type;
+  ResetNode(node);
+  return node;
+}
+
+XAttribute *XDocument::newAttr() {
+  if (freeAttrs_.empty())
+    return new XAttribute();
+
+  XAttribute *attr = freeAttrs_.back();
+  freeAttrs_.pop_back();
+  attr->key.clear();
+  attr->val.clear();
+  attr->nsId = XNS_NONE;
+  attr->localPos = 0;
+  return attr;
+}
+
+bool XDocument::load(XSource *src, const XParseOptions& opts,
+                     buffer_t *content) {
+  clear();
+
+  // 按魔数识别压缩的输入, 读出的字节由 peek 交还.
+  XPeekSource peek(src);
+  XCompression comp = XDetectCompression(peek.head, peek.len);
+  if (comp != xCompressNone)
+    return loadCompressed(&peek, comp, opts, content);
+
+  content->len = 0;
+  if (readContent(&peek, opts, content))
+    return false;
+
+  buffer_terminate(content);
+  if (parseContent(content->data, content->len, nullptr, opts))
+    return false;
+
+  // 直接接管内容缓冲区, 原有的缓冲区交给调用者复用.
+  if (opts.keepSource)
+    std::swap(*content, source_);
+  return true;
+}
+
+bool XDocument::loadCompressed(XSource *src, int comp,
+                               const XParseOptions& opts, buffer_t *content) {
+  // 解压在后台线程中进行, 解析器与之同时消费已经解压的部分.
+  XInflateSource inflater(src, (XCompression) comp);
+  if (!inflater.supported) {
+    setError(xErrBadFile, "unsupported compression format");
     return false;
   }
 
-  fseek(fp, 0, SEEK_SET);
-  size_t rn = fread(content, 1, len, fp);
-  if (rn != len) {
-    //
-    free(content);
+  XInflateStream stream(&inflater);
+  if (stream.start()) {
+    setError(xErrMemAlloc, "no enough memory");
     return false;
   }
-  fclose(fp);
 
-  parser.curr = content;
-  parser.end = content + len;
-  parser.loadComments = false;
+  if (load(&stream, opts, content))
+    return true;
+
+  // 解压出错时读取错误的原因更具体. 解析可能先于解压线程结束,
+  // 读取其状态之前需要等待线程退出.
+  stream.stop();
+  if (stream.tooLarge())
+    setError(xErrMemAlloc, "the decompressed content is too large");
+  else if (inflater.corrupt)
+    setError(xErrBadFile, "the compressed content is corrupted");
+  return false;
+}
+
+bool XDocument::readSource(XSource *src, const XParseOptions& opts,
+                           buffer_t *content) {
+  // 与 load 相同地识别压缩的输入, 但解压后整个读入 content. 调用者在
+  // 读完之后才开始扫描, 在后台线程中解压并没有好处.
+  XPeekSource peek(src);
+  XCompression comp = XDetectCompression(peek.head, peek.len);
+  if (comp == xCompressNone)
+    return readContent(&peek, opts, content);
+
+  XInflateSource inflater(&peek, comp);
+  if (!inflater.supported) {
+    setError(xErrBadFile, "unsupported compression format");
+    return true;
+  }
+
+  if (!readContent(&inflater, opts, content))
+    return false;
+  if (inflater.corrupt)
+    setError(xErrBadFile, "the compressed content is corrupted");
+  return true;
+}
+
+// 流式加载时对逐步到达的原始内容进行转码或校验, 只把处理完成的部分
+// 交给解析器.
+struct XStreamFeed : XFeed {
+  XDocument           *doc;
+  XStream             *stream;
+  const XParseOptions *opts;
+  buffer_t            *out;     // 转码结果, 容量预先分配, 地址不变.
+
+  XEncoding  enc;
+  size_t     bom;
+  size_t     arrived;  // 已到达的原始字节数.
+  size_t     consumed; // 已转码的原始字节数.
+  size_t     checked;  // 已校验的内容长度.
+  ContentPtr content;
+  size_t     length;   // 解析器可见的内容长度.
+  bool       failed;
+
+  XStreamFeed(XDocument *d, XStream *s, const XParseOptions *o, buffer_t *b) {
+    doc = d;
+    stream = s;
+    opts = o;
+    out = b;
+    enc = xEncodingUnknown;
+    bom = arrived = consumed = checked = length = 0;
+    content = nullptr;
+    failed = false;
+  }
+
+  bool start();
+  bool advance();
+  bool more(ContentPtr *end) override;
+};
+
+bool XStreamFeed::start() {
+  // 等到足以判断编码的内容到达.
+  while (arrived < 4096 && arrived < stream->size) {
+    if (stream->wait(arrived, &arrived)) {
+      doc->setError(xErrBadFile, "failed to read the xml content");
+      return true;
+    }
+  }
+
+  if (arrived == 0) {
+    doc->setError(xErrEmptyFile, "the xml file is empty");
+    return true;
+  }
+
+  enc = XDetectEncoding(stream->data, arrived, &bom);
+  if (enc == xEncodingUnknown) {
+    enc = XDeclaredEncoding(stream->data, arrived);
+    if (enc == xEncodingUnknown) {
+      doc->setError(xErrEncoding, "unsupported encoding");
+      return true;
+    }
+  }
+
+  if (enc == xEncodingUTF8) {
+    content = stream->data + bom;
+  } else {
+    // 转码结果不超过原长度的 2 倍, 一次分配足够的空间以保证地址不变,
+    // 之后每次到达的内容都在这块空间中追加转码, 解析与读取重叠进行.
+    // 长度未知(如解压的输入)时只能等全部内容到达.
+    while (stream->size == (size_t) -1) {
+      if (stream->wait(arrived, &arrived)) {
+        doc->setError(xErrBadFile, "failed to read the xml content");
+        return true;
+      }
+    }
+    if (buffer_reserve(out, stream->size * 2)) {
+      doc->setError(xErrMemAlloc, "no enough memory");
+      return true;
+    }
+    content = out->data;
+  }
+
+  consumed = bom;
+  return advance();
+}
+
+bool XStreamFeed::advance() {
+  bool final = arrived == stream->size;
+
+  if (enc == xEncodingUTF8) {
+    size_t avail = arrived - bom, bad;
+    if (!opts->validateUTF8) {
+      length = avail;
+    } else if (ValidateTail(content, avail, &checked, final, &bad)) {
+      char txt[64];
+      snprintf(txt, sizeof(txt), "invalid UTF-8 sequence at offset %zu",
+               bad + bom);
+      doc->setError(xErrEncoding, txt, bad + bom);
+      return true;
+    } else {
+      length = checked;
+    }
+    return false;
+  }
+
+  size_t n;
+  if (XTranscode(enc, stream->data + consumed, arrived - consumed, &n, out)) {
+    doc->setError(xErrEncoding, "invalid character in the source encoding");
+    return true;
+  }
+  consumed += n;
+  if (final && consumed != arrived) {
+    doc->setError(xErrIncompleteDoc, "truncated character at the end of file");
+    return true;
+  }
+
+  assert(out->data == content);
+  length = out->len;
+  return false;
+}
+
+bool XStreamFeed::more(ContentPtr *end) {
+  size_t old = length;
+  while (!failed && length == old) {
+    if (arrived == stream->size)
+      return false;
+
+    if (stream->wait(arrived, &arrived)) {
+      doc->setError(xErrBadFile, "failed to read the xml content");
+      failed = true;
+    } else if (advance()) {
+      failed = true;
+    }
+  }
+
+  if (failed)
+    return false;
+
+  *end = content + length;
+  return true;
+}
+
+bool XDocument::load(XStream *stream, const XParseOptions& opts,
+                     buffer_t *content) {
+  clear();
+
+  content->len = 0;
+  XStreamFeed feed(this, stream, &opts, content);
+  if (feed.start())
+    return false;
+
+  if (parseContent(feed.content, feed.length, &feed, opts))
+    return false;
+
+  // 未转码时内容位于输入方的缓冲区中, 需要复制一份.
+  if (opts.keepSource) {
+    if (buffer_reserve(&source_, feed.length)) {
+      clear();
+      setError(xErrMemAlloc, "no enough memory");
+      return false;
+    }
+    memcpy(source_.data, feed.content, feed.length);
+    source_.len = feed.length;
+  }
+  return true;
+}
+
+// 读入全部内容并转码为 UTF-8. 原始字节逐块读取与转码, 但转码的结果
+// 保存在一块完整的缓冲区中: 解析器与节点的源内容位置都直接指向连续
+// 的内容, 因此内存占用仍与 UTF-8 内容的大小成正比, 省去的只是原始
+// 内容的副本.
+bool XDocument::readContent(XSource *src, const XParseOptions& opts,
+                            buffer_t *content) {
+  // 长度仅用于预留空间, 无法获取时按块读到结束为止.
+  size_t hint = src->sizeHint();
+
+  char   raw[XDOC_BLOCK_SIZE];
+  size_t rawLen = src->read(raw, sizeof(raw));
+  if (rawLen == 0) {
+    if (src->failed) {
+      setError(xErrBadFile, "failed to read the xml content");
+      return true;
+    }
+    setError(xErrEmptyFile, "the xml file is empty");
+    return true;
+  }
+
+  size_t bom;
+  XEncoding enc = XDetectEncoding(raw, rawLen, &bom);
+  if (enc == xEncodingUnknown) {
+    enc = XDeclaredEncoding(raw, rawLen);
+    if (enc == xEncodingUnknown) {
+      setError(xErrEncoding, "unsupported encoding");
+      return true;
+    }
+  }
+
+  if (enc == xEncodingUTF8) {
+    // 无需转码, 直接读入内容缓冲区.
+    if (buffer_reserve(content, hint > rawLen ? hint : rawLen)) {
+      setError(xErrMemAlloc, "no enough memory");
+      return true;
+    }
+    memcpy(content->data, raw + bom, rawLen - bom);
+    content->len = rawLen - bom;
+
+    // 校验与读取交替进行, 每块数据在仍处于缓存中时完成校验.
+    size_t checked = 0, bad = 0;
+    bool invalid = false;
+
+    while (true) {
+      if (opts.validateUTF8 && ValidateTail(content->data, content->len, &checked,
+                                             false, &bad)) {
+        invalid = true;
+        break;
+      }
+
+      if (content->len == content->cap) {
+        char ch;
+        if (src->read(&ch, 1) == 0) break;
+        if (buffer_reserve(content, XDOC_BLOCK_SIZE)) {
+          setError(xErrMemAlloc, "no enough memory");
+          return true;
+        }
+        content->data[content->len++] = ch;
+      }
+      size_t rn = src->read(content->data + content->len,
+                            content->cap - content->len);
+      if (rn == 0) break;
+      content->len += rn;
+    }
+
+    if (opts.validateUTF8 && !invalid)
+      invalid = ValidateTail(content->data, content->len, &checked,
+                             true, &bad);
+    if (invalid) {
+      char txt[64];
+      snprintf(txt, sizeof(txt), "invalid UTF-8 sequence at offset %zu",
+               bad + bom);
+      setError(xErrEncoding, txt, bad + bom);
+      return true;
+    }
+  } else {
+    // 逐块转码为 UTF-8 并追加到 content, 原始数据同一时刻只保留一个块.
+    size_t off = bom;
+    while (true) {
+      size_t consumed;
+      if (XTranscode(enc, raw + off, rawLen - off, &consumed, content)) {
+        setError(xErrEncoding, "invalid character in the source encoding");
+        return true;
+      }
+      off += consumed;
+
+      size_t rest = rawLen - off;
+      memmove(raw, raw + off, rest);
+      size_t rn = src->read(raw + rest, sizeof(raw) - rest);
+      if (rn == 0) {
+        if (rest != 0) {
+          setError(xErrIncompleteDoc, "truncated character at the end of file");
+          return true;
+        }
+        break;
+      }
+      rawLen = rest + rn;
+      off = 0;
+    }
+  }
+
+  if (src->failed) {
+    setError(xErrBadFile, "failed to read the xml content");
+    return true;
+  }
+  return false;
+}
+
+bool XDocument::parseContent(const char *data, size_t len, XFeed *feed,
+                             const XParseOptions& opts) {
+  XParser parser;
+
+  parser.begin = data;
+  parser.curr = data;
+  parser.end = data + len;
+  parser.opts = &opts;
+  parser.feed = feed;
   parser.doc = this;
-  bool res = !parser.parse();
+  parser.order = 0;
+  if (parser.parse()) {
+    // 读取或转码的错误已经由输入方设置.
+    if (error_ == xNoErr)
+      setError(xErrParse, "failed to parse the xml content");
+    return true;
+  }
 
-  free(content);
-  return res;
+  return false;
+}
+
+void XDocument::setError(XError err, const char *txt, size_t offset) {
+  error_ = err;
+  errtxt_ = txt;
+  erroff_ = offset;
+}
+
+// 保存时的序列化. 有源内容时未修改的节点直接复制源内容, 被修改的
+// 元素中相邻两个源节点之间的内容(被丢弃的空白, 未加载的注释以及被跳过
+// 的元素)也从源内容中复制.
+struct XSaver {
+  XWriter    *out;
+  const char *src; // 没有保留源内容时为空.
+
+  bool sourced(XNode *node) {
+    return src != nullptr && node->srcEnd != 0;
+  }
+
+  void copy(size_t b, size_t e) {
+    out->raw(src + b, e - b);
+  }
+
+  void put(const char *s, size_t len) {
+    out->raw(s, len);
+  }
+
+  void put(const std::string& s) {
+    out->raw(s.c_str(), s.length());
+  }
+
+  void escape(const std::string& s, bool attr) {
+    out->escaped(s.c_str(), s.length(), attr);
+  }
+
+  void node(XNode *node);
+  void element(XElement *ele);
+  void startTag(XElement *ele, bool empty);
+};
+
+void XSaver::node(XNode *node) {
+  if (node->type == xNodeTypeElement) {
+    element((XElement *) node);
+  } else if (sourced(node) && !node->dirty) {
+    copy(node->srcBeg, node->srcEnd);
+  } else if (node->type == xNodeTypeComment) {
+    put("<!--", 4);
+    put(node->txt);
+    put("-->", 3);
+  } else {
+    escape(node->txt, false);
+  }
+}
+
+void XSaver::element(XElement *ele) {
+  bool src = sourced(&ele->node);
+  if (src && !ele->node.dirty && !ele->node.childDirty) {
+    copy(ele->node.srcBeg, ele->node.srcEnd);
+    return;
+  }
+
+  // 以 "/>" 结束的源元素没有可以复用的结束标签.
+  bool open = src && ele->srcTagEnd != ele->node.srcEnd;
+  bool empty = LLIST_EMPTY(&ele->children.llnode);
+
+  if (open && !ele->node.dirty) {
+    copy(ele->node.srcBeg, ele->srcTagEnd);
+  } else {
+    startTag(ele, empty && !open);
+    if (empty && !open)
+      return;
+  }
+
+  // cursor 为上一个源节点在源内容中的结束位置.
+  size_t cursor = open ? ele->srcTagEnd : (size_t) -1;
+  for (XNode *n = ele->children.next(); n != &ele->children; n = n->next()) {
+    if (sourced(n)) {
+      if (cursor <= n->srcBeg)
+        copy(cursor, n->srcBeg);
+      node(n);
+      cursor = n->srcEnd;
+    } else {
+      node(n);
+    }
+  }
+  if (cursor <= ele->srcCloseBeg)
+    copy(cursor, ele->srcCloseBeg);
+
+  if (open && !ele->node.dirty) {
+    copy(ele->srcCloseBeg, ele->node.srcEnd);
+  } else {
+    put("</", 2);
+    put(ele->name());
+    put(">", 1);
+  }
+}
+
+void XSaver::startTag(XElement *ele, bool empty) {
+  put("<", 1);
+  put(ele->name());
+
+  rbnode_t *rbn = rbt_min(ele->attrs.root);
+  while (rbn) {
+    XAttribute *attr = (XAttribute *) rbn;
+    // 值中的双引号转义为 &quot;, 单引号无需处理.
+    put(" ", 1);
+    put(attr->key);
+    put("=\"", 2);
+    escape(attr->val, true);
+    put("\"", 1);
+    rbn = rbt_next(rbn);
+  }
+
+  if (empty)
+    put("/>", 2);
+  else
+    put(">", 1);
+}
+
+static bool IsUTF8Name(const std::string& enc) {
+  // 编码名不区分大小写.
+  std::string name(enc);
+  for (size_t i = 0; i < name.length(); i++) {
+    if (name[i] >= 'A' && name[i] <= 'Z')
+      name[i] += 'a' - 'A';
+  }
+  return name == "utf-8" || name == "utf8";
 }
 
 bool XDocument::save(const std::string& path) {
+  const std::string& target = path.empty() ? filePath_ : path;
+  if (root_ == nullptr || target.empty()) {
+    setError(xErrMisuse, "nothing to save or no file path");
+    return false;
+  }
+
+  // 目标是符号链接时替换它指向的文件, 链接本身保持不变.
+  std::string dest = target;
+  char *real = realpath(target.c_str(), NULL);
+  if (real != NULL) {
+    dest = real;
+    free(real);
+  }
+
+  // 先写入同一目录下的临时文件, 全部写出后再替换目标文件, 写出失败时
+  // 原有的文件保持不变.
+  std::string tmp = dest + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (fp == NULL) {
+    setError(xErrBadFile, "can't open the output file");
+    return false;
+  }
+
+  // 替换已有的文件时沿用其权限与属主. 没有权限修改属主时忽略.
+  struct stat st;
+  if (stat(dest.c_str(), &st) == 0) {
+    int rc = fchown(fileno(fp), st.st_uid, st.st_gid);
+    (void) rc;
+    fchmod(fileno(fp), st.st_mode & 07777);
+  }
+
+  bool ok;
+  {
+    XWriter out([fp](const char *data, size_t len) {
+      return fwrite(data, 1, len, fp) == len;
+    });
+    XSaver saver;
+    saver.out = &out;
+    saver.src = source_.len != 0 ? source_.data : nullptr;
+
+    // 源文件不是 UTF-8 时文档头中声明的编码需要重新生成, 文档头之后
+    // 根元素之前的注释, 处理指令与 DOCTYPE 仍然复制源内容.
+    bool src = saver.sourced(&root_->node);
+    if (src && (hencoding_.empty() || IsUTF8Name(hencoding_))) {
+      saver.copy(0, root_->node.srcBeg);
+    } else if (!hversion_.empty()) {
+      saver.put("<?xml version=\"", 15);
+      saver.put(hversion_);
+      saver.put("\" encoding=\"UTF-8\"", 18);
+      if (!hstandalone_.empty()) {
+        saver.put(" standalone=\"", 13);
+        saver.put(hstandalone_);
+        saver.put("\"", 1);
+      }
+      saver.put("?>", 2);
+      if (src)
+        saver.copy(hend_, root_->node.srcBeg);
+      else
+        saver.put("\n", 1);
+    }
+
+    saver.element(root_);
+    if (src)
+      saver.copy(root_->node.srcEnd, source_.len);
+
+    ok = out.finish();
+  }
+
+  if (fclose(fp) != 0)
+    ok = false;
+  if (ok && rename(tmp.c_str(), dest.c_str()) != 0)
+    ok = false;
+  if (!ok) {
+    remove(tmp.c_str());
+    setError(xErrWrite, "failed to write the output file");
+    return false;
+  }
   return true;
 }
 
@@ -571,16 +1857,50 @@ std::string XDocument::errorText() {
   return errtxt_;
 }
 
+size_t XDocument::errorOffset() {
+  return erroff_;
+}
+
+XNsId XDocument::namespaceId(const std::string& uri) const {
+  // 文档中的命名空间通常只有几个, 顺序查找即可.
+  for (size_t i = 0; i < nsUris_.size(); i++) {
+    if (nsUris_[i] == uri)
+      return (XNsId) i;
+  }
+  return XNS_UNKNOWN;
+}
+
+const std::string& XDocument::namespaceUri(XNsId id) const {
+  if (id >= nsUris_.size())
+    return nsUris_[XNS_NONE];
+  return nsUris_[id];
+}
+
+XNsId XDocument::internNamespace(const std::string& uri) {
+  XNsId id = namespaceId(uri);
+  if (id != XNS_UNKNOWN)
+    return id;
+  nsUris_.push_back(uri);
+  return (XNsId) (nsUris_.size() - 1);
+}
+
 XElement *XDocument::root() {
   return root_;
 }
 
 void XDocument::setRoot(XElement&& root) {
-  if (root_ == nullptr)
-    root_ = new XElement();
+  if (root_ != nullptr)
+    recycle(root_);
+  root_ = newElement();
 
   root_->node.txt = std::move(root.node.txt);
+  root_->node.pre = root.node.pre;
+  root_->node.post = root.node.post;
 
   llist_move(&root_->children.llnode, &root.children.llnode);
   rbtree_move(&root_->attrs, &root.attrs);
+
+  for (XNode *n = root_->children.next(); n != &root_->children; n = n->next())
+    n->owner = root_;
+  root_->node.dirty = true;
 }
\ No newline at end of file
@@ -7,8 +7,13 @@
 
 #include "rbtree.h"
 #include "llist.h"
+#include "buffer.h"
 
+#include <iosfwd>
+#include <stdint.h>
+#include <stdio.h>
 #include <string>
+#include <vector>
 
 enum XError {
   xNoErr,
@@ -17,8 +22,20 @@ enum XError {
   xErrEmptyFile,
   xErrIncompleteDoc,
   xErrParse,
+  xErrEncoding,
+  xErrWrite,
+  xErrMisuse,
 };
 
+///@brief 命名空间 URI 在文档内的编号, 同一文档中相同的 URI 编号相同.
+/// 编号只在加载它的文档中有意义, 重新加载后会重新分配.
+typedef uint32_t XNsId;
+
+#define XNS_NONE    0 // 不属于任何命名空间.
+#define XNS_XML     1 // 前缀 xml 固定绑定的命名空间.
+#define XNS_XMLNS   2 // xmlns 属性所属的命名空间.
+#define XNS_UNKNOWN ((XNsId) -1) // 文档中不存在的 URI, 不与任何节点匹配.
+
 enum XNodeType {
   xNodeTypeNone,
   xNodeTypeElement,
@@ -29,19 +46,59 @@ enum XNodeType {
 ///@brief 由于 xml 其结构与 树 的结构同理， 所以我们可以将文档中
 /// 任何东西都映射成树中的节点, 这里的节点是一个抽象的，由于仅元素
 /// 类型的节点才拥有子节点，所以节点无需拥有子节点字段。
+struct XElement;
+
 struct XNode {
   llnode_t    llnode;
   XNodeType   type;
   std::string txt;
 
+  ///@brief 所属的父元素, 根元素与尚未加入树中的节点为空.
+  XElement   *owner;
+  ///@brief 加载时节点在源内容中的范围 [srcBeg, srcEnd), 不是由解析
+  /// 得到的节点 srcEnd 为 0. 仅在保留了源内容时用于增量保存.
+  size_t      srcBeg;
+  size_t      srcEnd;
+  ///@brief 节点自身(文本, 元素名或属性)在加载后被修改过.
+  bool        dirty;
+  ///@brief 元素的子孙节点或子节点列表在加载后被修改过.
+  bool        childDirty;
+
+  ///@brief 文档顺序的编号: 元素的子孙节点的编号都在 (pre, post) 之间,
+  /// 其他节点 pre 与 post 相等. 相邻的编号之间留有间隔, 添加子节点时
+  /// 从间隔中分配; 间隔用完时新节点的编号为 0, 在下一次查询顺序时
+  /// 整棵树重新编号.
+  uint64_t    pre;
+  uint64_t    post;
+  ///@brief 节点的深度, 根元素为 0.
+  size_t      depth;
+
   XNode(XNodeType t) {
     type = t;
+    owner = nullptr;
+    srcBeg = srcEnd = 0;
+    dirty = childDirty = false;
+    pre = post = 0;
+    depth = 0;
   }
 
-  ///@brief 设置节点文本
-  void setTxt(const char *t, int len = -1);
+  XElement *parent() const {
+    return owner;
+  }
+
+  ///@brief 比较两个节点在文档中的先后, 返回负数, 0 或正数.
+  /// 两个节点必须位于同一棵树中.
+  int compareDocumentOrder(XNode *other);
+
+  ///@brief 设置节点文本, len 为 npos 时按 '\0' 结尾计算长度.
+  void setTxt(const char *t, size_t len = std::string::npos);
   void setTxt(const std::string& t);
 
+  ///@brief 标记节点已被修改, 保存时将重新生成而不是复制源内容.
+  /// 通过 setTxt/setName/addAttr/addChild* 修改时会自动标记, 直接修改
+  /// txt 或属性值时需要手动调用.
+  void markDirty();
+
   ///@brief 获取上一个同级节点
   XNode *prev();
   ///@brief 获取下一个同级节点
@@ -52,6 +109,20 @@ struct XAttribute {
   rbnode_t rbnode;
   std::string key;
   std::string val;
+
+  ///@brief 启用命名空间处理时属性名所属的命名空间, 以及本地名在 key
+  /// 中的起始位置. 没有前缀的属性不属于任何命名空间.
+  XNsId  nsId;
+  size_t localPos;
+
+  XAttribute() {
+    nsId = XNS_NONE;
+    localPos = 0;
+  }
+
+  const char *localName() const {
+    return key.c_str() + localPos;
+  }
 };
 
 ///@brief 注释与文本节点无特别之处，直接使用 XNode 即可.
@@ -66,6 +137,17 @@ struct XElement {
   XNode    children;
   rbtree_t attrs;
 
+  ///@brief 开始标签结束('>' 之后)与结束标签开始('<' 处)在源内容中的
+  /// 位置, 以 "/>" 结束的元素两者都等于 node.srcEnd.
+  size_t srcTagEnd;
+  size_t srcCloseBeg;
+
+  ///@brief 启用命名空间处理时元素名所属的命名空间, 以及本地名在元素名
+  /// 中的起始位置(没有前缀时为 0). 只在解析时设置, setName 之后分别
+  /// 重置为 XNS_NONE 与 0, 需要时由调用者重新设置.
+  XNsId  nsId;
+  size_t localPos;
+
   XElement();
   ~XElement();
 
@@ -73,22 +155,48 @@ struct XElement {
     return node.txt;
   }
 
+  XElement *parent() const {
+    return node.owner;
+  }
+
+  size_t depth() const {
+    return node.depth;
+  }
+
+  ///@brief 判断 n 是否为此元素的子孙节点, 两者必须位于同一棵树中.
+  bool isAncestorOf(XNode *n);
+  bool isAncestorOf(XElement *ele) {
+    return isAncestorOf(&ele->node);
+  }
+
+  ///@brief 去掉前缀之后的元素名. 通过 name() 直接修改过元素名时
+  /// localPos 可能已经失效, 此时返回完整的元素名.
+  const char *localName() const {
+    if (localPos > node.txt.length())
+      return node.txt.c_str();
+    return node.txt.c_str() + localPos;
+  }
+
   /// @brief 设置元素名
-  void setName(const char *name, int len = -1) {
+  void setName(const char *name, size_t len = std::string::npos) {
     node.setTxt(name, len);
+    nsId = XNS_NONE;
+    localPos = 0;
   }
   void setName(const std::string& name) {
-    node.setTxt(name.c_str(), (int) name.length());
+    setName(name.c_str(), name.length());
   }
 
-  ///@brief 添加属性，需要提供属性名称.
-  XAttribute *addAttr(const char *key, int len = -1);
+  ///@brief 添加属性，需要提供属性名称. 属性已经存在时返回原有的属性.
+  XAttribute *addAttr(const char *key, size_t len = std::string::npos);
   XAttribute *addAttr(const std::string& key);
   ///@brief 通过属性名称查找.
   XAttribute *operator [] (const char *key) const;
   XAttribute *operator [] (const std::string& key) const;
   XAttribute *findAttr(const char *key) const;
   XAttribute *findAttr(const std::string& key) const;
+  ///@brief 按命名空间与本地名查找, 命名空间只比较编号.
+  XAttribute *findAttr(XNsId ns, const char *local) const;
 
   ///@brief 添加一个子节点，共3种不同的节点类型.
   XComments *addChildComment();
@@ -104,8 +212,18 @@ struct XElement {
   /// 若没则返回 null.
   XElement *prev();
   XElement *next();
+
+  ///@brief 按命名空间与本地名查找首个子元素或下一个同级元素,
+  /// 命名空间只比较编号. 若没有则返回 null.
+  XElement *child(XNsId ns, const char *local);
+  XElement *next(XNsId ns, const char *local);
 };
 
+///@brief 按文档顺序排序并去掉重复的节点, 用于整理查询的结果.
+/// 节点必须位于同一棵树中.
+void XSortDocumentOrder(std::vector<XNode *>& nodes);
+void XSortDocumentOrder(std::vector<XElement *>& elements);
+
 /// @brief: 遍历所有子元素.
 /// @note: 在遍历期间请勿改变
 #define ELEMENT_FOREACH(child, ele)        \
@@ -114,31 +232,144 @@ struct XElement {
        (child) = (child)->next()           \
   )
 
+///@brief 文档加载选项.
+struct XParseOptions {
+  ///@brief 解析前校验输入是否为合法的 UTF-8, 出错时可通过
+  /// XDocument::errorOffset() 获得首个非法字节在文件中的偏移.
+  /// 由其他编码转码而来的内容总是合法的, 不会重复校验.
+  bool validateUTF8;
+
+  ///@brief 是否保留注释节点.
+  bool loadComments;
+  ///@brief 丢弃标签之间仅由空白组成的文本.
+  bool dropBlankText;
+  ///@brief 去除文本节点首尾的空白, 去除后为空的文本节点将被丢弃.
+  bool trimText;
+  ///@brief 名称在此列表中的元素(不含根元素)连同其子树整个跳过,
+  /// 解析器只统计标签深度, 不会为其分配任何节点.
+  std::vector<std::string> skipElements;
+  ///@brief 保留加载时的源内容(转码后的 UTF-8). 保存时未修改的节点直接
+  /// 复制源内容, 格式, 注释以及被跳过的部分都保持原样.
+  /// 会额外占用与文档大小相当的内存.
+  bool keepSource;
+  ///@brief 处理命名空间: 解析时维护前缀的作用域, 为元素与属性设置
+  /// nsId 与 localPos. 使用未声明的前缀时加载失败. 仅 XDocument 支持.
+  bool namespaces;
+
+  XParseOptions() {
+    validateUTF8  = false;
+    loadComments  = false;
+    dropBlankText = true;
+    trimText      = false;
+    keepSource    = false;
+    namespaces    = false;
+  }
+};
+
+struct XSource;
+struct XStream;
+struct XFeed;
+
 class XDocument {
 public:
   XDocument();
   XDocument(const std::string& path);
   ~XDocument();
 
-  bool load(const std::string& path);
+  bool load(const std::string& path,
+            const XParseOptions& opts = XParseOptions());
+  ///@brief 从内存中加载文档, 编码处理与 load 相同.
+  bool loadBuffer(const char *data, size_t len,
+                  const XParseOptions& opts = XParseOptions());
+  ///@brief 从文件描述符的当前位置读到结束并加载, 不要求可以定位,
+  /// 因此可用于管道与标准输入. 文件描述符由调用者关闭.
+  bool loadFd(int fd, const XParseOptions& opts = XParseOptions());
+  ///@brief 从输入流的当前位置读到结束并加载.
+  bool load(std::istream& in, const XParseOptions& opts = XParseOptions());
+  ///@brief 保存为 UTF-8 编码的文件, path 为空时保存到加载时的路径.
+  /// 重新生成的文本与属性值会转义 '<', '&' 等字符, 已有的实体引用
+  /// 保持不变, 属性值总是以双引号括起. 加载时指定了
+  /// keepSource 时只重新生成被修改过的节点, 其余部分直接复制源内容.
+  /// 内容先写入 path + ".tmp", 成功后再替换目标文件. path 是符号链接时
+  /// 替换其指向的文件, 已有文件的权限沿用, 属主在有权限时沿用.
   bool save(const std::string& path = {});
   XError      error();
   std::string errorText();
+  ///@brief 出错位置在源文件中的字节偏移, 仅部分错误提供.
+  size_t      errorOffset();
+
+  ///@brief 文档头 <?xml ...?> 中的声明, 未声明时为空.
+  /// 注意内容在加载时已统一转码为 UTF-8, encoding() 仅反映源文件.
+  const std::string& version() const { return hversion_; }
+  const std::string& encoding() const { return hencoding_; }
+  const std::string& standalone() const { return hstandalone_; }
+
+  ///@brief 命名空间 URI 的编号, 文档中没有出现时为 XNS_UNKNOWN.
+  /// URI 按加载时的原样比较, 不展开实体引用.
+  XNsId namespaceId(const std::string& uri) const;
+  ///@brief 编号对应的 URI, 编号无效时为空.
+  const std::string& namespaceUri(XNsId id) const;
 
   XElement *root();
 
   void setRoot(XElement &&root);
 
+  ///@brief 清空文档内容. 原有的节点不会被释放, 而是留给下一次
+  /// 加载复用, 因此反复使用同一个 XDocument 加载文档时分配更少.
+  void clear();
+
 private:
+  friend struct XParser;
+  friend struct XStreamFeed;
+  friend class XBatchLoader;
+  friend class XAsyncLoader;
+  friend class XBinder;
+  friend class XExtractor;
+  friend struct XSaver;
+
+  void setError(XError err, const char *txt, size_t offset = 0);
+
+  bool loadFile(const std::string& path, const XParseOptions& opts,
+                buffer_t *content);
+  bool load(XSource *src, const XParseOptions& opts, buffer_t *content);
+  bool load(XStream *stream, const XParseOptions& opts, buffer_t *content);
+  bool loadCompressed(XSource *src, int comp, const XParseOptions& opts,
+                      buffer_t *content);
+  bool readContent(XSource *src, const XParseOptions& opts, buffer_t *content);
+  bool readSource(XSource *src, const XParseOptions& opts, buffer_t *content);
+  bool parseContent(const char *data, size_t len, XFeed *feed,
+                    const XParseOptions& opts);
+
   std::string filePath_;
   XError      error_;
   std::string errtxt_;
+  size_t      erroff_;
 
   std::string hversion_;
   std::string hencoding_;
   std::string hstandalone_;
+  // 文档头在源内容中的结束位置('?>' 之后), 没有文档头时为 0.
+  size_t      hend_;
 
   XElement *root_;
+
+  // 加载时保留的源内容, 未保留时长度为 0.
+  buffer_t source_;
+
+  // 按编号存放的命名空间 URI, 开头是预定义的几个.
+  std::vector<std::string> nsUris_;
+  XNsId internNamespace(const std::string& uri);
+
+  void recycle(XElement *ele);
+  void recycle(XAttribute *attr);
+  XElement   *newElement();
+  XNode      *newNode(XNodeType type);
+  XAttribute *newAttr();
+
+  // 被回收的节点, 解析时优先从这里取用.
+  std::vector<XElement *>   freeElements_;
+  std::vector<XNode *>      freeNodes_;
+  std::vector<XAttribute *> freeAttrs_;
 };
 
 #endif //LIBXDOC_DOCUMENT_H
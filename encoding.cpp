@@ -0,0 +1,540 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#include "encoding.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XDOC_SSE2
+#endif
+
+// UTF-8 校验的查表需要 SSSE3 的 pshufb. 编译选项未启用时, GCC 与 Clang
+// 单独为该函数生成代码, 运行时再检查 CPU 是否支持.
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define XDOC_SSSE3
+#define XDOC_SSSE3_TARGET
+#define XDOC_HAS_SSSE3() true
+#elif defined(XDOC_SSE2) && defined(__GNUC__)
+#include <tmmintrin.h>
+#define XDOC_SSSE3
+#define XDOC_SSSE3_TARGET __attribute__((target("ssse3")))
+#define XDOC_HAS_SSSE3() __builtin_cpu_supports("ssse3")
+#endif
+
+typedef const unsigned char *BytePtr;
+
+static inline char *EncodeUTF8(char *o, uint32_t uc) {
+  if (uc < 0x80) {
+    *o++ = (char) uc;
+  } else if (uc < 0x800) {
+    *o++ = (char) (0xC0 | (uc >> 6));
+    *o++ = (char) (0x80 | (uc & 0x3F));
+  } else if (uc < 0x10000) {
+    *o++ = (char) (0xE0 | (uc >> 12));
+    *o++ = (char) (0x80 | ((uc >> 6) & 0x3F));
+    *o++ = (char) (0x80 | (uc & 0x3F));
+  } else {
+    *o++ = (char) (0xF0 | (uc >> 18));
+    *o++ = (char) (0x80 | ((uc >> 12) & 0x3F));
+    *o++ = (char) (0x80 | ((uc >> 6) & 0x3F));
+    *o++ = (char) (0x80 | (uc & 0x3F));
+  }
+  return o;
+}
+
+static inline uint32_t LoadU16(BytePtr p, bool be) {
+  return be ? ((uint32_t) p[0] << 8 | p[1])
+            : ((uint32_t) p[1] << 8 | p[0]);
+}
+
+static inline uint32_t LoadU32(BytePtr p, bool be) {
+  return be ? ((uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 |
+               (uint32_t) p[2] << 8  | p[3])
+            : ((uint32_t) p[3] << 24 | (uint32_t) p[2] << 16 |
+               (uint32_t) p[1] << 8  | p[0]);
+}
+
+static inline char LowerAscii(char ch) {
+  return (ch >= 'A' && ch <= 'Z') ? (char) (ch - 'A' + 'a') : ch;
+}
+
+static bool NameEquals(const char *name, size_t len, const char *lit) {
+  size_t n = strlen(lit);
+  if (n != len)
+    return false;
+  for (size_t i = 0; i < n; i++) {
+    if (LowerAscii(name[i]) != lit[i])
+      return false;
+  }
+  return true;
+}
+
+XEncoding XDetectEncoding(const char *data, size_t len, size_t *bomLen) {
+  BytePtr p = (BytePtr) data;
+  *bomLen = 0;
+
+  if (len >= 4) {
+    if (p[0] == 0x00 && p[1] == 0x00 && p[2] == 0xFE && p[3] == 0xFF) {
+      *bomLen = 4;
+      return xEncodingUTF32BE;
+    }
+    if (p[0] == 0xFF && p[1] == 0xFE && p[2] == 0x00 && p[3] == 0x00) {
+      *bomLen = 4;
+      return xEncodingUTF32LE;
+    }
+    // 没有 BOM 时, 文档必然以 '<' 开头, 依据其字节排列推断.
+    if (p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x00 && p[3] == 0x3C)
+      return xEncodingUTF32BE;
+    if (p[0] == 0x3C && p[1] == 0x00 && p[2] == 0x00 && p[3] == 0x00)
+      return xEncodingUTF32LE;
+    if (p[0] == 0x00 && p[1] == 0x3C && p[2] == 0x00 && p[3] == 0x3F)
+      return xEncodingUTF16BE;
+    if (p[0] == 0x3C && p[1] == 0x00 && p[2] == 0x3F && p[3] == 0x00)
+      return xEncodingUTF16LE;
+  }
+
+  if (len >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
+    *bomLen = 3;
+    return xEncodingUTF8;
+  }
+
+  if (len >= 2) {
+    if (p[0] == 0xFE && p[1] == 0xFF) {
+      *bomLen = 2;
+      return xEncodingUTF16BE;
+    }
+    if (p[0] == 0xFF && p[1] == 0xFE) {
+      *bomLen = 2;
+      return xEncodingUTF16LE;
+    }
+  }
+
+  return xEncodingUnknown;
+}
+
+XEncoding XDeclaredEncoding(const char *data, size_t len) {
+  // XMLDecl ::= '<?xml' VersionInfo EncodingDecl? SDDecl? S? '?>'
+  if (len < 6 || memcmp(data, "<?xml", 5) != 0)
+    return xEncodingUTF8;
+
+  const char *end  = data + len;
+  const char *decl = (const char *) memchr(data, '>', len);
+  if (decl != NULL)
+    end = decl;
+
+  const char *p = data + 5;
+  while (end - p > 8) {
+    if (*p != 'e' || memcmp(p, "encoding", 8) != 0) {
+      p++;
+      continue;
+    }
+
+    p += 8;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+      p++;
+    if (p == end || *(p++) != '=')
+      break;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+      p++;
+    if (p == end || (*p != '"' && *p != '\''))
+      break;
+
+    const char  quote = *(p++);
+    const char *nbeg  = p;
+    while (p < end && *p != quote)
+      p++;
+    if (p == end)
+      break;
+
+    size_t n = p - nbeg;
+    if (NameEquals(nbeg, n, "utf-8") || NameEquals(nbeg, n, "utf8")
+     || NameEquals(nbeg, n, "us-ascii") || NameEquals(nbeg, n, "ascii"))
+      return xEncodingUTF8;
+    if (NameEquals(nbeg, n, "iso-8859-1") || NameEquals(nbeg, n, "iso_8859-1")
+     || NameEquals(nbeg, n, "latin1") || NameEquals(nbeg, n, "latin-1")
+     || NameEquals(nbeg, n, "l1"))
+      return xEncodingLatin1;
+    // 字节排列已经是 ASCII 兼容的, UTF-16/32 的声明与实际内容不符,
+    // 按 UTF-8 处理.
+    if (n >= 6 && NameEquals(nbeg, 6, "utf-16"))
+      return xEncodingUTF8;
+    if (n >= 6 && NameEquals(nbeg, 6, "utf-32"))
+      return xEncodingUTF8;
+    return xEncodingUnknown;
+  }
+
+  return xEncodingUTF8;
+}
+
+static bool TranscodeUTF16(BytePtr p, size_t len, bool be,
+                           size_t *consumed, char **out) {
+  BytePtr s = p;
+  BytePtr e = p + (len & ~(size_t) 1);
+  char   *o = *out;
+
+  while (p < e) {
+    BytePtr run = p + 2;
+#ifdef XDOC_SSE2
+    // 每次检查 16 个编码单元, 全部为 ASCII 时直接压缩为 16 字节写出.
+    if (e - p >= 32) {
+      __m128i a = _mm_loadu_si128((const __m128i *) p);
+      __m128i b = _mm_loadu_si128((const __m128i *) (p + 16));
+      if (be) {
+        a = _mm_or_si128(_mm_srli_epi16(a, 8), _mm_slli_epi16(a, 8));
+        b = _mm_or_si128(_mm_srli_epi16(b, 8), _mm_slli_epi16(b, 8));
+      }
+      __m128i hi = _mm_and_si128(_mm_or_si128(a, b),
+                                 _mm_set1_epi16((short) 0xFF80));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(hi, _mm_setzero_si128())) == 0xFFFF) {
+        _mm_storeu_si128((__m128i *) o, _mm_packus_epi16(a, b));
+        o += 16;
+        p += 32;
+        continue;
+      }
+      run = p + 32;
+    }
+#endif
+    while (p < run) {
+      uint32_t uc = LoadU16(p, be);
+      if (uc >= 0xD800 && uc <= 0xDFFF) {
+        if (uc >= 0xDC00)
+          goto bad; // 孤立的低代理项.
+        if (e - p < 4)
+          goto done; // 代理对被块尾截断, 留到下一块.
+        uint32_t lo = LoadU16(p + 2, be);
+        if (lo < 0xDC00 || lo > 0xDFFF)
+          goto bad;
+        uc = 0x10000 + ((uc - 0xD800) << 10) + (lo - 0xDC00);
+        p += 2;
+      }
+      o = EncodeUTF8(o, uc);
+      p += 2;
+    }
+  }
+
+done:
+  *consumed = p - s;
+  *out = o;
+  return false;
+
+bad:
+  *consumed = p - s;
+  *out = o;
+  return true;
+}
+
+static bool TranscodeUTF32(BytePtr p, size_t len, bool be,
+                           size_t *consumed, char **out) {
+  BytePtr s = p;
+  BytePtr e = p + (len & ~(size_t) 3);
+  char   *o = *out;
+
+  while (p < e) {
+    BytePtr run = p + 4;
+#ifdef XDOC_SSE2
+    if (e - p >= 64) {
+      __m128i a = _mm_loadu_si128((const __m128i *) p);
+      __m128i b = _mm_loadu_si128((const __m128i *) (p + 16));
+      __m128i c = _mm_loadu_si128((const __m128i *) (p + 32));
+      __m128i d = _mm_loadu_si128((const __m128i *) (p + 48));
+      // 大端序的码点在按小端载入后位于每个 32 位通道的最高字节.
+      __m128i mask = _mm_set1_epi32(be ? (int) 0x80FFFFFF : (int) 0xFFFFFF80);
+      __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+      any = _mm_and_si128(any, mask);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(any, _mm_setzero_si128())) == 0xFFFF) {
+        if (be) {
+          a = _mm_srli_epi32(a, 24);
+          b = _mm_srli_epi32(b, 24);
+          c = _mm_srli_epi32(c, 24);
+          d = _mm_srli_epi32(d, 24);
+        }
+        __m128i ab = _mm_packs_epi32(a, b);
+        __m128i cd = _mm_packs_epi32(c, d);
+        _mm_storeu_si128((__m128i *) o, _mm_packus_epi16(ab, cd));
+        o += 16;
+        p += 64;
+        continue;
+      }
+      run = p + 64;
+    }
+#endif
+    while (p < run) {
+      uint32_t uc = LoadU32(p, be);
+      if (uc > 0x10FFFF || (uc >= 0xD800 && uc <= 0xDFFF)) {
+        *consumed = p - s;
+        *out = o;
+        return true;
+      }
+      o = EncodeUTF8(o, uc);
+      p += 4;
+    }
+  }
+
+  *consumed = p - s;
+  *out = o;
+  return false;
+}
+
+static void TranscodeLatin1(BytePtr p, size_t len, char **out) {
+  BytePtr e = p + len;
+  char   *o = *out;
+
+  while (p < e) {
+    BytePtr run = p + 1;
+#ifdef XDOC_SSE2
+    if (e - p >= 16) {
+      __m128i a = _mm_loadu_si128((const __m128i *) p);
+      if (_mm_movemask_epi8(a) == 0) {
+        _mm_storeu_si128((__m128i *) o, a);
+        o += 16;
+        p += 16;
+        continue;
+      }
+      run = p + 16;
+    }
+#endif
+    while (p < run) {
+      o = EncodeUTF8(o, *p);
+      p++;
+    }
+  }
+
+  *out = o;
+}
+
+bool XTranscode(XEncoding enc, const char *in, size_t len,
+                size_t *consumed, buffer_t *out) {
+  // 各编码转为 UTF-8 后的长度都不会超过原长度的 2 倍.
+  if (len > ((size_t) -1) / 2 || buffer_reserve(out, len * 2)) {
+    *consumed = 0;
+    return true;
+  }
+
+  char *o = out->data + out->len;
+  bool err = false;
+
+  switch (enc) {
+  case xEncodingUTF16LE:
+  case xEncodingUTF16BE:
+    err = TranscodeUTF16((BytePtr) in, len, enc == xEncodingUTF16BE,
+                         consumed, &o);
+    break;
+  case xEncodingUTF32LE:
+  case xEncodingUTF32BE:
+    err = TranscodeUTF32((BytePtr) in, len, enc == xEncodingUTF32BE,
+                         consumed, &o);
+    break;
+  case xEncodingLatin1:
+    TranscodeLatin1((BytePtr) in, len, &o);
+    *consumed = len;
+    break;
+  case xEncodingUTF8:
+    memcpy(o, in, len);
+    o += len;
+    *consumed = len;
+    break;
+  default:
+    *consumed = 0;
+    return true;
+  }
+
+  out->len = o - out->data;
+  return err;
+}
+
+#ifdef XDOC_SSSE3
+// 按 Keiser 与 Lemire 的查表法 (Validating UTF-8 In Less Than One
+// Instruction Per Byte) 每次校验 16 个字节. 每个字节与其前一个字节的
+// 高低半字节各查一张表, 三者相与后非 0 即为非法的字节对; 再由前第二,
+// 第三个字节判断哪些位置必须是续字节.
+#define XU8_TOO_SHORT  0x01 // 首字节之后不是续字节.
+#define XU8_TOO_LONG   0x02 // ASCII 之后是续字节.
+#define XU8_OVERLONG_3 0x04 // E0 80..9F
+#define XU8_TOO_LARGE  0x08 // F4 90..BF 与 F5..FF
+#define XU8_SURROGATE  0x10 // ED A0..BF
+#define XU8_OVERLONG_2 0x20 // C0..C1
+#define XU8_TOO_LARGE2 0x40 // F5..FF 80..8F
+#define XU8_OVERLONG_4 0x40 // F0 80..8F
+#define XU8_TWO_CONTS  0x80 // 续字节之后是续字节.
+#define XU8_CARRY      (XU8_TOO_SHORT | XU8_TOO_LONG | XU8_TWO_CONTS)
+
+///@brief 返回需要逐字节检查的起点: 出错的块或不足 16 字节的尾部所在
+/// 字符的首字节, 之前的内容均合法.
+XDOC_SSSE3_TARGET
+static BytePtr ValidateUTF8SSSE3(BytePtr p, BytePtr e) {
+  // 前一个字节的高半字节.
+  const __m128i byte1High = _mm_setr_epi8(
+    XU8_TOO_LONG, XU8_TOO_LONG, XU8_TOO_LONG, XU8_TOO_LONG,
+    XU8_TOO_LONG, XU8_TOO_LONG, XU8_TOO_LONG, XU8_TOO_LONG,
+    (char) XU8_TWO_CONTS, (char) XU8_TWO_CONTS,
+    (char) XU8_TWO_CONTS, (char) XU8_TWO_CONTS,
+    XU8_TOO_SHORT | XU8_OVERLONG_2,
+    XU8_TOO_SHORT,
+    XU8_TOO_SHORT | XU8_OVERLONG_3 | XU8_SURROGATE,
+    XU8_TOO_SHORT | XU8_TOO_LARGE | XU8_TOO_LARGE2 | XU8_OVERLONG_4);
+  // 前一个字节的低半字节.
+  const __m128i byte1Low = _mm_setr_epi8(
+    (char) (XU8_CARRY | XU8_OVERLONG_3 | XU8_OVERLONG_2 | XU8_OVERLONG_4),
+    (char) (XU8_CARRY | XU8_OVERLONG_2),
+    (char) XU8_CARRY,
+    (char) XU8_CARRY,
+    (char) (XU8_CARRY | XU8_TOO_LARGE),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2 | XU8_SURROGATE),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2),
+    (char) (XU8_CARRY | XU8_TOO_LARGE | XU8_TOO_LARGE2));
+  // 当前字节的高半字节.
+  const __m128i byte2High = _mm_setr_epi8(
+    XU8_TOO_SHORT, XU8_TOO_SHORT, XU8_TOO_SHORT, XU8_TOO_SHORT,
+    XU8_TOO_SHORT, XU8_TOO_SHORT, XU8_TOO_SHORT, XU8_TOO_SHORT,
+    (char) (XU8_TOO_LONG | XU8_OVERLONG_2 | XU8_TWO_CONTS | XU8_OVERLONG_3
+          | XU8_TOO_LARGE2 | XU8_OVERLONG_4),
+    (char) (XU8_TOO_LONG | XU8_OVERLONG_2 | XU8_TWO_CONTS | XU8_OVERLONG_3
+          | XU8_TOO_LARGE),
+    (char) (XU8_TOO_LONG | XU8_OVERLONG_2 | XU8_TWO_CONTS | XU8_SURROGATE
+          | XU8_TOO_LARGE),
+    (char) (XU8_TOO_LONG | XU8_OVERLONG_2 | XU8_TWO_CONTS | XU8_SURROGATE
+          | XU8_TOO_LARGE),
+    XU8_TOO_SHORT, XU8_TOO_SHORT, XU8_TOO_SHORT, XU8_TOO_SHORT);
+  // 块的最后三个字节超过这些值时, 字符延续到了下一块.
+  const __m128i lastMax = _mm_setr_epi8(
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    (char) (0xF0 - 1), (char) (0xE0 - 1), (char) (0xC0 - 1));
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i zero = _mm_setzero_si128();
+
+  BytePtr s = p;
+  __m128i prev = zero;
+  __m128i incomplete = zero;
+
+  for (; e - p >= 16; p += 16) {
+    __m128i in = _mm_loadu_si128((const __m128i *) p);
+    if (_mm_movemask_epi8(in) == 0) {
+      // 全部为 ASCII, 只需上一块没有以未完成的字符结束. XML 内容绝大
+      // 部分是 ASCII, 之后每次跳过 32 个字节.
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(incomplete, zero)) != 0xFFFF)
+        break;
+      incomplete = zero;
+      while (e - p >= 48) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (p + 16));
+        __m128i b = _mm_loadu_si128((const __m128i *) (p + 32));
+        if (_mm_movemask_epi8(_mm_or_si128(a, b)) != 0)
+          break;
+        in = b;
+        p += 32;
+      }
+      prev = in;
+      continue;
+    }
+
+    __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+    __m128i sc = _mm_and_si128(
+      _mm_and_si128(
+        _mm_shuffle_epi8(byte1High,
+                         _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+        _mm_shuffle_epi8(byte1Low, _mm_and_si128(prev1, nibble))),
+      _mm_shuffle_epi8(byte2High,
+                       _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+
+    // 三字节与四字节字符的第三, 四个字节必须是续字节, 此时前面的查表
+    // 恰好只得到 XU8_TWO_CONTS, 异或之后抵消.
+    __m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+    __m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+    __m128i must23 = _mm_or_si128(
+      _mm_subs_epu8(prev2, _mm_set1_epi8((char) (0xE0 - 0x80))),
+      _mm_subs_epu8(prev3, _mm_set1_epi8((char) (0xF0 - 0x80))));
+    __m128i err = _mm_xor_si128(
+      _mm_and_si128(must23, _mm_set1_epi8((char) 0x80)), sc);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(err, zero)) != 0xFFFF)
+      break;
+
+    incomplete = _mm_subs_epu8(in, lastMax);
+    prev = in;
+  }
+
+  // 退回到跨越块边界的字符的首字节, 之前的字符都已校验过.
+  for (int i = 0; i < 3 && p > s && (p[-1] & 0xC0) == 0x80; i++)
+    p--;
+  if (p > s && p[-1] >= 0xC0)
+    p--;
+  return p;
+}
+#endif
+
+bool XValidateUTF8(const char *data, size_t len, size_t *pos) {
+  BytePtr p = (BytePtr) data;
+  BytePtr e = p + len;
+
+#ifdef XDOC_SSSE3
+  // 之后的逐字节检查只处理尾部, 或在出错时找出具体的位置.
+  if (XDOC_HAS_SSSE3())
+    p = ValidateUTF8SSSE3(p, e);
+#endif
+
+  while (p < e) {
+    BytePtr run = p + 1;
+#ifdef XDOC_SSE2
+    // XML 内容绝大部分是 ASCII, 每次跳过 32 个字节.
+    if (e - p >= 32) {
+      __m128i a = _mm_loadu_si128((const __m128i *) p);
+      __m128i b = _mm_loadu_si128((const __m128i *) (p + 16));
+      if (_mm_movemask_epi8(_mm_or_si128(a, b)) == 0) {
+        p += 32;
+        continue;
+      }
+      run = p + 32;
+    }
+#endif
+    while (p < run && p < e) {
+      unsigned char c = *p;
+      if (c < 0x80) {
+        p++;
+        continue;
+      }
+
+      // 参照 Unicode 标准表 3-7 (Well-Formed UTF-8 Byte Sequences),
+      // 第二个字节的取值范围随首字节而变化.
+      size_t n;
+      unsigned char lo = 0x80, hi = 0xBF;
+      if (c >= 0xC2 && c <= 0xDF) {
+        n = 2;
+      } else if (c >= 0xE0 && c <= 0xEF) {
+        n = 3;
+        if (c == 0xE0) lo = 0xA0;
+        if (c == 0xED) hi = 0x9F;
+      } else if (c >= 0xF0 && c <= 0xF4) {
+        n = 4;
+        if (c == 0xF0) lo = 0x90;
+        if (c == 0xF4) hi = 0x8F;
+      } else {
+        goto bad;
+      }
+
+      if ((size_t) (e - p) < n || p[1] < lo || p[1] > hi)
+        goto bad;
+      for (size_t i = 2; i < n; i++) {
+        if ((p[i] & 0xC0) != 0x80)
+          goto bad;
+      }
+      p += n;
+    }
+  }
+
+  return false;
+
+bad:
+  *pos = p - (BytePtr) data;
+  return true;
+}
@@ -0,0 +1,46 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_ENCODING_H
+#define LIBXDOC_ENCODING_H
+
+#include "buffer.h"
+
+#include <stddef.h>
+
+enum XEncoding {
+  xEncodingUnknown,
+  xEncodingUTF8,
+  xEncodingUTF16LE,
+  xEncodingUTF16BE,
+  xEncodingUTF32LE,
+  xEncodingUTF32BE,
+  xEncodingLatin1,
+};
+
+///@brief 根据文档开头的 BOM 或 '<' 的字节排列探测编码.
+/// 无法判断时(ASCII 兼容的编码)返回 xEncodingUnknown, 此时应
+/// 继续通过 XDeclaredEncoding 查看声明.
+///@param bomLen 返回需要跳过的 BOM 字节数.
+XEncoding XDetectEncoding(const char *data, size_t len, size_t *bomLen);
+
+///@brief 读取 ASCII 兼容文档 <?xml ... encoding="..."?> 中声明的编码.
+/// 没有声明时返回 xEncodingUTF8, 不支持的编码返回 xEncodingUnknown.
+XEncoding XDeclaredEncoding(const char *data, size_t len);
+
+///@brief 将 in 转码为 UTF-8 并追加到 out 末尾.
+/// 块尾不完整的编码单元(或代理对)不会被消费, 由调用者拼接到下一块
+/// 数据之前再次传入.
+///@param consumed 返回已处理的字节数; 出错时为非法编码单元的偏移.
+///@return true 表示遇到非法编码单元或内存不足.
+bool XTranscode(XEncoding enc, const char *in, size_t len,
+                size_t *consumed, buffer_t *out);
+
+///@brief 校验 data 是否为合法的 UTF-8 (拒绝过长编码, 代理项与超出
+/// U+10FFFF 的码点). 末尾被截断的字符同样视为非法.
+///@param pos 出错时返回首个非法字节的偏移.
+///@return true 表示存在非法字节.
+bool XValidateUTF8(const char *data, size_t len, size_t *pos);
+
+#endif //LIBXDOC_ENCODING_H
@@ -0,0 +1,254 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#include "extract.h"
+#include "parser.h"
+#include "source.h"
+
+struct XExtractor::Scan {
+  XParser                   parser;
+  const std::vector<Step>  *steps;
+  XDocument                *doc;
+  const XExtractCallback   *cb;
+  bool                      stopped;
+
+  // levels[d] 为深度 d 的元素所处的前缀树节点集合, 有通配符时可能
+  // 同时处于多个节点.
+  std::vector<std::vector<int>> levels;
+
+  bool child(size_t depth, ContentPtr nbeg, ContentPtr nend);
+  bool element(size_t depth, ContentPtr nbeg, ContentPtr nend);
+  bool deliver(size_t depth, ContentPtr nbeg, ContentPtr nend);
+};
+
+bool XExtractor::Scan::child(size_t depth, ContentPtr nbeg, ContentPtr nend) {
+  // curr 位于子元素名之后, 父元素位于深度 depth.
+  if (levels.size() <= depth + 1)
+    levels.resize(depth + 2);
+
+  const std::vector<int>& from = levels[depth];
+  std::vector<int>&       to = levels[depth + 1];
+  size_t len = nend - nbeg;
+  bool   matched = false;
+
+  to.clear();
+  for (size_t i = 0; i < from.size(); i++) {
+    const Step& step = (*steps)[from[i]];
+    for (size_t j = 0; j < step.children.size(); j++) {
+      const std::string& name = step.children[j].first;
+      if (name.length() == len && memcmp(name.c_str(), nbeg, len) == 0)
+        to.push_back(step.children[j].second);
+    }
+    if (step.wildcard >= 0)
+      to.push_back(step.wildcard);
+  }
+
+  for (size_t i = 0; i < to.size(); i++) {
+    if (!(*steps)[to[i]].matches.empty())
+      matched = true;
+  }
+
+  if (to.empty())
+    return parser.SkipElement();
+  if (matched)
+    return deliver(depth + 1, nbeg, nend);
+  return element(depth + 1, nbeg, nend);
+}
+
+bool XExtractor::Scan::element(size_t depth, ContentPtr nbeg, ContentPtr nend) {
+  // 位于路径前缀上的元素, 属性直接跳过, 只检查子元素的名字.
+  bool closed;
+  if (parser.SkipTag(&closed)) return true;
+  if (closed) return false;
+
+  while (true) {
+    if (parser.FindChar('<')) return true;
+    parser.curr++;
+    if (parser.IsEnd()) return true;
+
+    if (*parser.curr == '/') {
+      ContentPtr ebeg, eend;
+      parser.curr++;
+      if (parser.MatchName(ebeg, eend)) return true;
+      if (eend - ebeg != nend - nbeg || memcmp(ebeg, nbeg, nend - nbeg) != 0)
+        return true;
+      if (parser.SkipBlank()) return true;
+      return *(parser.curr++) != '>';
+    } else if (*parser.curr == '!') {
+      if (parser.Avail(3) && memcmp(parser.curr, "!--", 3) == 0) {
+        if (parser.SkipTo("-->", 3)) return true;
+      } else if (parser.Avail(8) && memcmp(parser.curr, "![CDATA[", 8) == 0) {
+        if (parser.SkipTo("]]>", 3)) return true;
+      } else {
+        if (parser.SkipTo(">", 1)) return true;
+      }
+    } else if (*parser.curr == '?') {
+      if (parser.SkipTo("?>", 2)) return true;
+    } else {
+      ContentPtr cbeg, cend;
+      if (parser.MatchName(cbeg, cend)) return true;
+      if (child(depth, cbeg, cend)) return true;
+    }
+  }
+}
+
+bool XExtractor::Scan::deliver(size_t depth, ContentPtr nbeg, ContentPtr nend) {
+  XElement *ele = doc->newElement();
+  ele->node.txt.assign(nbeg, nend - nbeg);
+  ele->node.srcBeg = nbeg - 1 - parser.begin;
+  if (parser.parseElementBody(ele)) {
+    doc->recycle(ele);
+    return true;
+  }
+
+  const std::vector<int>& states = levels[depth];
+  for (size_t i = 0; i < states.size() && !stopped; i++) {
+    const std::vector<size_t>& matches = (*steps)[states[i]].matches;
+    for (size_t j = 0; j < matches.size() && !stopped; j++) {
+      if (!(*cb)(matches[j], *ele))
+        stopped = true;
+    }
+  }
+
+  doc->recycle(ele);
+  // 停止时借用出错的路径直接退出扫描.
+  return stopped;
+}
+
+XExtractor::XExtractor() {
+  steps_.resize(1);
+  steps_[0].wildcard = -1;
+  count_ = 0;
+  buffer_init(&content_);
+}
+
+XExtractor::~XExtractor() {
+  buffer_free(&content_);
+}
+
+bool XExtractor::addPath(const std::string& path) {
+  if (path.empty() || path[0] != '/')
+    return false;
+
+  std::vector<std::string> names;
+  size_t pos = 1;
+  while (true) {
+    size_t next = path.find('/', pos);
+    if (next == std::string::npos)
+      next = path.length();
+    if (next == pos)
+      return false;
+    names.push_back(path.substr(pos, next - pos));
+    if (next == path.length())
+      break;
+    pos = next + 1;
+  }
+
+  int curr = 0;
+  for (size_t i = 0; i < names.size(); i++) {
+    int next = -1;
+    if (names[i] == "*") {
+      next = steps_[curr].wildcard;
+    } else {
+      std::vector<std::pair<std::string, int>>& children = steps_[curr].children;
+      for (size_t j = 0; j < children.size(); j++) {
+        if (children[j].first == names[i])
+          next = children[j].second;
+      }
+    }
+
+    if (next < 0) {
+      next = (int) steps_.size();
+      steps_.push_back(Step());
+      steps_[next].wildcard = -1;
+      if (names[i] == "*")
+        steps_[curr].wildcard = next;
+      else
+        steps_[curr].children.push_back(std::make_pair(names[i], next));
+    }
+    curr = next;
+  }
+
+  steps_[curr].matches.push_back(count_++);
+  return true;
+}
+
+XError XExtractor::error() {
+  return doc_.error();
+}
+
+std::string XExtractor::errorText() {
+  return doc_.errorText();
+}
+
+size_t XExtractor::errorOffset() {
+  return doc_.errorOffset();
+}
+
+bool XExtractor::load(const std::string& path, const XExtractCallback& cb,
+                      const XParseOptions& opts) {
+  doc_.clear();
+
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == NULL) {
+    doc_.setError(xErrBadFile, "can't open the xml file");
+    return false;
+  }
+
+  XFileSource src(fp);
+  content_.len = 0;
+  bool res = !doc_.readSource(&src, opts, &content_);
+
+  fclose(fp);
+  return res && extract(cb, opts);
+}
+
+bool XExtractor::loadBuffer(const char *data, size_t len,
+                            const XExtractCallback& cb,
+                            const XParseOptions& opts) {
+  doc_.clear();
+
+  XMemorySource src(data, len);
+  content_.len = 0;
+  if (doc_.readSource(&src, opts, &content_))
+    return false;
+
+  return extract(cb, opts);
+}
+
+bool XExtractor::extract(const XExtractCallback& cb,
+                         const XParseOptions& opts) {
+  buffer_terminate(&content_);
+
+  // 路径上的元素不解析属性, 无法得到外层的前缀声明, 因此不处理命名空间.
+  XParseOptions local = opts;
+  local.namespaces = false;
+
+  Scan scan;
+  scan.parser.begin = content_.data;
+  scan.parser.curr = content_.data;
+  scan.parser.end = content_.data + content_.len;
+  scan.parser.opts = &local;
+  scan.parser.order = 0;
+  scan.parser.feed = nullptr;
+  scan.parser.doc = &doc_;
+  scan.steps = &steps_;
+  scan.doc = &doc_;
+  scan.cb = &cb;
+  scan.stopped = false;
+  scan.levels.resize(1);
+  scan.levels[0].push_back(0);
+
+  XParser& p = scan.parser;
+  ContentPtr nbeg, nend;
+  bool failed = p.parseProlog() || p.SkipMisc() || *(p.curr++) != '<'
+             || p.MatchName(nbeg, nend) || scan.child(0, nbeg, nend);
+
+  if (failed && !scan.stopped) {
+    if (doc_.error() == xNoErr)
+      doc_.setError(xErrParse, "failed to parse the xml content");
+    return false;
+  }
+  return true;
+}
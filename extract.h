@@ -0,0 +1,71 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_EXTRACT_H
+#define LIBXDOC_EXTRACT_H
+
+#include "document.h"
+
+#include <functional>
+
+///@brief 提取到一个匹配的元素时的回调, index 为匹配的路径的编号.
+/// ele 仅在回调期间有效. 返回 false 将停止提取.
+typedef std::function<bool(size_t index, XElement& ele)> XExtractCallback;
+
+///@brief 按路径从文档中提取少量元素, 不构建整个文档.
+/// 路径形如 "/feed/entry/id", 从根元素开始逐级给出元素名, "*" 匹配任意
+/// 名字. 扫描时只有位于某条路径前缀上的元素才会读取名字, 其余子树只
+/// 统计标签深度直接跳过, 不解析名字与属性.
+///
+/// 匹配的元素连同其子树被解析为一个 XElement 交给回调, 解析选项与
+/// XDocument 相同(不支持 namespaces). 回调之后节点被回收, 供下一个匹配
+/// 复用, 因此节点占用的内存只与单个匹配元素的大小有关. 匹配元素内部
+/// 不再继续匹配其他路径.
+///
+/// @note 扫描之前整个文档会先读入(必要时解压并转码为 UTF-8)内存, loadBuffer
+/// 同样会复制一份, 因此内存占用仍与文档大小成正比, 节省的只是节点.
+class XExtractor {
+public:
+  XExtractor();
+  ~XExtractor();
+
+  XExtractor(const XExtractor&) = delete;
+  XExtractor& operator = (const XExtractor&) = delete;
+
+  ///@brief 添加一条路径, 编号为添加的顺序(从 0 开始).
+  /// 路径格式错误时返回 false.
+  bool addPath(const std::string& path);
+  size_t paths() const { return count_; }
+
+  ///@brief 扫描整个文件, 被回调停止时同样视为成功.
+  bool load(const std::string& path, const XExtractCallback& cb,
+            const XParseOptions& opts = XParseOptions());
+  bool loadBuffer(const char *data, size_t len, const XExtractCallback& cb,
+                  const XParseOptions& opts = XParseOptions());
+
+  XError      error();
+  std::string errorText();
+  size_t      errorOffset();
+
+private:
+  // 由全部路径组成的前缀树, 0 号为文档本身.
+  struct Step {
+    std::vector<std::pair<std::string, int>> children;
+    int                 wildcard; // "*" 对应的子节点, 没有时为 -1.
+    std::vector<size_t> matches;  // 在此结束的路径编号.
+  };
+
+  struct Scan;
+
+  bool extract(const XExtractCallback& cb, const XParseOptions& opts);
+
+  std::vector<Step> steps_;
+  size_t            count_;
+
+  // 用于读取内容, 记录错误以及提供可复用的节点.
+  XDocument doc_;
+  buffer_t  content_;
+};
+
+#endif //LIBXDOC_EXTRACT_H
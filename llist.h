@@ -39,6 +39,11 @@ static void llist_remove(llnode_t *node) {
 }
 
 static void llist_move(llnode_t *dst, llnode_t *src) {
+  if (LLIST_EMPTY(src)) {
+    llist_init(dst);
+    return;
+  }
+
   dst->next = src->next;
   dst->prev = src->prev;
   src->next->prev = dst;
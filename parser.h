@@ -0,0 +1,97 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_PARSER_H
+#define LIBXDOC_PARSER_H
+
+// 解析器的内部声明, 供库内其他不构建 DOM 的解析方式复用词法部分.
+
+#include "document.h"
+
+#include <stdint.h>
+
+#define IS_BLANK(ch) ( \
+  (ch) == 0x20 || (ch) == 0x9 || (ch) == 0xD || (ch) == 0xA \
+)
+
+typedef const char *ContentPtr;
+
+///@brief 流式解析时内容的提供者, 解析器读到 end 时通过它等待后续
+/// 内容到达. 内容所在的缓冲区地址保持不变, 只有 end 会向后移动.
+struct XFeed {
+  virtual ~XFeed() {}
+  ///@brief 等待更多内容并更新 *end, 已经没有更多内容(或出错)时返回 false.
+  virtual bool more(ContentPtr *end) = 0;
+};
+
+// 一个命名空间前缀的绑定, 前缀指向所在 xmlns 属性的属性名, 默认命名
+// 空间的前缀为空.
+struct XNsBinding {
+  const char *prefix;
+  size_t      len;
+  XNsId       ns;
+};
+
+struct XParser {
+  ContentPtr begin; // 内容的起始位置, 用于计算节点在源内容中的范围.
+  ContentPtr curr;
+  ContentPtr end;
+
+  const XParseOptions *opts;
+
+  // 一次性加载时为空.
+  XFeed *feed;
+
+  XDocument *doc;
+
+  // 处理命名空间时当前位置有效的前缀绑定, 按声明的顺序由外向内排列.
+  std::vector<XNsBinding> nsScope;
+  // 检查重复的扩展名时暂存当前元素带前缀的属性, 在元素之间复用.
+  std::vector<XAttribute *> nsAttrs;
+
+  // 最近分配的文档顺序编号.
+  uint64_t order;
+
+  bool parse();
+  bool parseProlog();
+  bool parseElement(XElement *ele);
+  bool parseElementBody(XElement *ele);
+  bool parseElementAttrs(XElement *ele);
+  bool parseElementChildren(XElement *ele);
+
+  XElement   *addElement(XElement *parent);
+  XNode      *addNode(XElement *parent, XNodeType type);
+  XAttribute *addAttr(XElement *ele, ContentPtr b, ContentPtr e);
+
+  bool DeclareNs(XAttribute *attr);
+  bool ResolveNs(XElement *ele);
+  bool ResolveName(const std::string& name, bool attr,
+                   XNsId *ns, size_t *local);
+  XNsId LookupNs(const char *prefix, size_t len);
+
+  bool parseComment(XElement *parent);
+  bool parseText(XElement *parent);
+  void addText(XElement *parent, ContentPtr b, ContentPtr e);
+
+  bool IsSkipped(ContentPtr b, ContentPtr e);
+  bool SkipElement();
+  bool SkipTag(bool *closed);
+  bool SkipTo(const char *seq, size_t len);
+  bool FindChar(char ch);
+
+  bool SkipBlank();
+  bool SkipMisc();
+  bool MatchName(ContentPtr& b, ContentPtr& e);
+  bool MatchNameStartChar();
+  bool MatchNameChar();
+  bool MatchRefVal(ContentPtr& b, ContentPtr& e);
+
+  bool IsEnd();
+  bool More();
+  bool Avail(size_t n);
+
+  bool DecodeUTF8(uint32_t *unicode);
+};
+
+#endif //LIBXDOC_PARSER_H
@@ -0,0 +1,163 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_SOURCE_H
+#define LIBXDOC_SOURCE_H
+
+#include <errno.h>
+#include <istream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+///@brief 加载文档时原始字节的来源, XDocument 从中逐块读取内容,
+/// 再进行编码探测, 转码与校验.
+struct XSource {
+  bool failed;
+
+  XSource() {
+    failed = false;
+  }
+  virtual ~XSource() {}
+
+  ///@brief 读取至多 n 个字节, 返回 0 表示已经结束或出错(设置 failed).
+  virtual size_t read(char *buf, size_t n) = 0;
+
+  ///@brief 内容的总长度, 仅用于预留空间, 未知时返回 0.
+  virtual size_t sizeHint() { return 0; }
+};
+
+struct XFileSource : XSource {
+  FILE *fp;
+
+  XFileSource(FILE *f) {
+    fp = f;
+  }
+
+  size_t read(char *buf, size_t n) override {
+    size_t rn = fread(buf, 1, n, fp);
+    if (rn == 0 && ferror(fp))
+      failed = true;
+    return rn;
+  }
+
+  size_t sizeHint() override {
+    // 管道等不可定位的输入无法获取长度.
+    size_t hint = 0;
+    off_t pos = ftello(fp);
+    if (pos >= 0 && fseeko(fp, 0, SEEK_END) == 0) {
+      off_t n = ftello(fp);
+      if (n > pos) hint = (size_t) (n - pos);
+      fseeko(fp, pos, SEEK_SET);
+    }
+    return hint;
+  }
+};
+
+///@brief 从文件描述符的当前位置读到结束, 可以是管道, 套接字或标准输入.
+struct XFdSource : XSource {
+  int fd;
+
+  XFdSource(int f) {
+    fd = f;
+  }
+
+  size_t read(char *buf, size_t n) override {
+    // 管道每次只返回已到达的部分, 凑满 n 个字节再返回, 编码探测需要
+    // 完整的首块.
+    size_t total = 0;
+    while (total < n) {
+      ssize_t rn = ::read(fd, buf + total, n - total);
+      if (rn < 0 && errno == EINTR)
+        continue;
+      if (rn < 0) {
+        failed = true;
+        break;
+      }
+      if (rn == 0)
+        break;
+      total += (size_t) rn;
+    }
+    return total;
+  }
+
+  size_t sizeHint() override {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+      return 0;
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    return pos >= 0 && st.st_size > pos ? (size_t) (st.st_size - pos) : 0;
+  }
+};
+
+struct XIStreamSource : XSource {
+  std::istream *in;
+
+  XIStreamSource(std::istream *i) {
+    in = i;
+  }
+
+  size_t read(char *buf, size_t n) override {
+    in->read(buf, (std::streamsize) n);
+    size_t rn = (size_t) in->gcount();
+    if (rn == 0 && in->bad())
+      failed = true;
+    return rn;
+  }
+
+  size_t sizeHint() override {
+    std::streambuf *sb = in->rdbuf();
+    if (sb == NULL)
+      return 0;
+    std::streamoff pos = sb->pubseekoff(0, std::ios::cur, std::ios::in);
+    if (pos < 0)
+      return 0;
+    std::streamoff n = sb->pubseekoff(0, std::ios::end, std::ios::in);
+    sb->pubseekpos(pos, std::ios::in);
+    return n > pos ? (size_t) (n - pos) : 0;
+  }
+};
+
+struct XMemorySource : XSource {
+  const char *data;
+  size_t      len;
+
+  XMemorySource(const char *d, size_t n) {
+    data = d;
+    len = n;
+  }
+
+  size_t read(char *buf, size_t n) override {
+    if (n > len) n = len;
+    memcpy(buf, data, n);
+    data += n;
+    len -= n;
+    return n;
+  }
+
+  size_t sizeHint() override {
+    return len;
+  }
+};
+
+///@brief 逐步到达的输入. 内容由其他线程(如异步 I/O 或解压)写入地址
+/// 固定的缓冲区 data[0, size), 解析可以在全部到达之前开始. 事先不知道
+/// 长度时 size 为 npos, 由 wait() 在全部到达时设置.
+struct XStream {
+  const char *data;
+  size_t      size;
+
+  XStream() {
+    data = NULL;
+    size = 0;
+  }
+  virtual ~XStream() {}
+
+  ///@brief 等待已到达的字节数超过 have, 通过 arrived 返回当前已到达的
+  /// 字节数. 全部到达时立即返回; 读取出错时返回 true.
+  virtual bool wait(size_t have, size_t *arrived) = 0;
+};
+
+#endif //LIBXDOC_SOURCE_H
@@ -0,0 +1,338 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#include "writer.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XDOC_SSE2
+#endif
+
+// 文本中需要转义的字符, 属性值还需要额外转义引号与空白控制符,
+// 否则重新读入时会被规范化为空格.
+static inline bool NeedEscape(char ch, bool attr) {
+  switch (ch) {
+  case '<': case '>': case '&': case '\r':
+    return true;
+  case '"': case '\n': case '\t':
+    return attr;
+  default:
+    return false;
+  }
+}
+
+static inline const char *EscapeOf(char ch, size_t *n) {
+  switch (ch) {
+  case '<':  *n = 4; return "&lt;";
+  case '>':  *n = 4; return "&gt;";
+  case '&':  *n = 5; return "&amp;";
+  case '"':  *n = 6; return "&quot;";
+  case '\r': *n = 5; return "&#13;";
+  case '\n': *n = 5; return "&#10;";
+  default:   *n = 4; return "&#9;";
+  }
+}
+
+// 返回开头无需转义的字节数.
+static size_t PlainRun(const char *p, size_t len, bool attr) {
+  size_t i = 0;
+#ifdef XDOC_SSE2
+  const __m128i lt = _mm_set1_epi8('<'), gt = _mm_set1_epi8('>');
+  const __m128i amp = _mm_set1_epi8('&'), cr = _mm_set1_epi8('\r');
+  const __m128i quot = _mm_set1_epi8('"'), lf = _mm_set1_epi8('\n');
+  const __m128i tab = _mm_set1_epi8('\t');
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) (p + i));
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt),
+                                          _mm_cmpeq_epi8(v, gt)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, amp),
+                                          _mm_cmpeq_epi8(v, cr)));
+    if (attr) {
+      m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, quot),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v, lf),
+                                                    _mm_cmpeq_epi8(v, tab))));
+    }
+    // 找到需要转义的字符时由下面的逐字节循环定位.
+    if (_mm_movemask_epi8(m) != 0)
+      break;
+  }
+#endif
+  while (i < len && !NeedEscape(p[i], attr))
+    i++;
+  return i;
+}
+
+// 返回开头的实体或字符引用(&name; 或 &#...;)的长度, 不是引用时返回 0.
+static size_t RefLength(const char *p, size_t len) {
+  size_t i = 1;
+  if (i < len && p[i] == '#')
+    i++;
+  size_t nbeg = i;
+  while (i < len && (isalnum((unsigned char) p[i]) || p[i] == '_'
+                     || p[i] == '.' || p[i] == '-' || p[i] == ':'))
+    i++;
+  if (i == nbeg || i == len || p[i] != ';')
+    return 0;
+  return i + 1;
+}
+
+static bool ValidName(const char *name, size_t len) {
+  if (len == 0)
+    return false;
+  for (size_t i = 0; i < len; i++) {
+    switch (name[i]) {
+    case ' ': case '\t': case '\r': case '\n': case '<': case '>':
+    case '&': case '"': case '\'': case '/': case '=': case '\0':
+      return false;
+    default:
+      break;
+    }
+  }
+  return true;
+}
+
+XWriter::XWriter(int fd, size_t bufSize) {
+  fd_ = fd;
+  cap_ = bufSize < 256 ? 256 : bufSize;
+  buf_ = (char *) malloc(cap_);
+  len_ = 0;
+  tagOpen_ = false;
+  written_ = false;
+  rootDone_ = false;
+  error_ = xNoErr;
+  if (buf_ == nullptr)
+    fail(xErrMemAlloc, "no enough memory");
+}
+
+XWriter::XWriter(const XWriteSink& sink, size_t bufSize)
+: XWriter(-1, bufSize)
+{
+  sink_ = sink;
+}
+
+XWriter::~XWriter() {
+  if (error_ == xNoErr)
+    flush();
+  free(buf_);
+}
+
+XError XWriter::error() {
+  return error_;
+}
+
+std::string XWriter::errorText() {
+  return errtxt_;
+}
+
+bool XWriter::fail(XError err, const char *txt) {
+  if (error_ == xNoErr) {
+    error_ = err;
+    errtxt_ = txt;
+  }
+  return false;
+}
+
+bool XWriter::declaration(const char *encoding, const char *standalone) {
+  if (error_ != xNoErr) return false;
+  if (written_)
+    return fail(xErrMisuse, "the declaration must come first");
+
+  written_ = true;
+  if (put("<?xml version=\"1.0\"", 19)) return false;
+  if (encoding != nullptr) {
+    if (put(" encoding=\"", 11) || put(encoding, strlen(encoding))
+     || put("\"", 1))
+      return false;
+  }
+  if (standalone != nullptr) {
+    if (put(" standalone=\"", 13) || put(standalone, strlen(standalone))
+     || put("\"", 1))
+      return false;
+  }
+  return !put("?>\n", 3);
+}
+
+bool XWriter::startElement(const char *name, size_t len) {
+  if (error_ != xNoErr) return false;
+  if (!ValidName(name, len))
+    return fail(xErrMisuse, "invalid element name");
+  if (rootDone_ && starts_.empty())
+    return fail(xErrMisuse, "only one root element is allowed");
+
+  if (closeTag() || put("<", 1) || put(name, len))
+    return false;
+
+  starts_.push_back(names_.size());
+  names_.append(name, len);
+  tagOpen_ = true;
+  written_ = true;
+  return true;
+}
+
+bool XWriter::startElement(const std::string& name) {
+  return startElement(name.c_str(), name.length());
+}
+
+bool XWriter::attribute(const char *key, size_t klen,
+                        const char *val, size_t vlen) {
+  if (error_ != xNoErr) return false;
+  if (!tagOpen_)
+    return fail(xErrMisuse, "attributes must follow a start tag");
+  if (!ValidName(key, klen))
+    return fail(xErrMisuse, "invalid attribute name");
+
+  return !(put(" ", 1) || put(key, klen) || put("=\"", 2)
+        || escape(val, vlen, true) || put("\"", 1));
+}
+
+bool XWriter::attribute(const std::string& key, const std::string& val) {
+  return attribute(key.c_str(), key.length(), val.c_str(), val.length());
+}
+
+bool XWriter::text(const char *txt, size_t len) {
+  if (error_ != xNoErr) return false;
+  if (starts_.empty())
+    return fail(xErrMisuse, "text must be inside the root element");
+
+  return !(closeTag() || escape(txt, len, false));
+}
+
+bool XWriter::text(const std::string& txt) {
+  return text(txt.c_str(), txt.length());
+}
+
+bool XWriter::raw(const char *data, size_t len) {
+  if (error_ != xNoErr) return false;
+  written_ = true;
+  return !(closeTag() || put(data, len));
+}
+
+bool XWriter::escaped(const char *data, size_t len, bool attr) {
+  if (error_ != xNoErr) return false;
+  written_ = true;
+  return !(closeTag() || escape(data, len, attr, true));
+}
+
+bool XWriter::comment(const char *txt, size_t len) {
+  if (error_ != xNoErr) return false;
+  // Comment ::= '<!--' ((Char - '-') | ('-' (Char - '-')))* '-->'
+  for (size_t i = 0; i < len; i++) {
+    if (txt[i] == '-' && (i + 1 == len || txt[i + 1] == '-'))
+      return fail(xErrMisuse, "comments can't contain \"--\"");
+  }
+
+  written_ = true;
+  return !(closeTag() || put("<!--", 4) || put(txt, len) || put("-->", 3));
+}
+
+bool XWriter::comment(const std::string& txt) {
+  return comment(txt.c_str(), txt.length());
+}
+
+bool XWriter::endElement() {
+  if (error_ != xNoErr) return false;
+  if (starts_.empty())
+    return fail(xErrMisuse, "no element to end");
+
+  size_t start = starts_.back();
+  if (tagOpen_) {
+    tagOpen_ = false;
+    if (put("/>", 2)) return false;
+  } else {
+    if (put("</", 2) || put(names_.c_str() + start, names_.size() - start)
+     || put(">", 1))
+      return false;
+  }
+
+  names_.resize(start);
+  starts_.pop_back();
+  if (starts_.empty())
+    rootDone_ = true;
+  return true;
+}
+
+bool XWriter::finish() {
+  if (error_ != xNoErr) return false;
+  if (!starts_.empty())
+    return fail(xErrMisuse, "unclosed elements remain");
+  return !flush();
+}
+
+bool XWriter::closeTag() {
+  if (!tagOpen_)
+    return false;
+  tagOpen_ = false;
+  return put(">", 1);
+}
+
+bool XWriter::put(const char *data, size_t len) {
+  if (cap_ - len_ < len) {
+    if (flush()) return true;
+    // 大块内容不经过缓冲区直接写出.
+    if (len >= cap_)
+      return emit(data, len);
+  }
+  memcpy(buf_ + len_, data, len);
+  len_ += len;
+  return false;
+}
+
+bool XWriter::escape(const char *data, size_t len, bool attr, bool keepRefs) {
+  while (len > 0) {
+    size_t n = PlainRun(data, len, attr);
+    if (put(data, n)) return true;
+    if (n == len) break;
+
+    size_t rlen = keepRefs && data[n] == '&' ? RefLength(data + n, len - n) : 0;
+    if (rlen != 0) {
+      if (put(data + n, rlen)) return true;
+      data += n + rlen;
+      len -= n + rlen;
+      continue;
+    }
+
+    size_t elen;
+    const char *ent = EscapeOf(data[n], &elen);
+    if (put(ent, elen)) return true;
+    data += n + 1;
+    len -= n + 1;
+  }
+  return false;
+}
+
+bool XWriter::flush() {
+  bool res = len_ != 0 && emit(buf_, len_);
+  len_ = 0;
+  return res;
+}
+
+bool XWriter::emit(const char *data, size_t len) {
+  bool failed = false;
+  if (fd_ >= 0) {
+    while (len > 0) {
+      ssize_t wn = write(fd_, data, len);
+      if (wn < 0 && errno == EINTR)
+        continue;
+      if (wn <= 0) {
+        failed = true;
+        break;
+      }
+      data += wn;
+      len -= (size_t) wn;
+    }
+  } else {
+    failed = !sink_ || !sink_(data, len);
+  }
+
+  if (failed) {
+    fail(xErrWrite, "failed to write the output");
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,97 @@
+//
+// Created by luo-zeqi on 2026/10/19.
+//
+
+#ifndef LIBXDOC_WRITER_H
+#define LIBXDOC_WRITER_H
+
+#include "document.h"
+
+#include <functional>
+
+// 默认的输出缓冲区大小.
+#define XDOC_WRITER_BUFFER (1024 * 1024)
+
+///@brief 写出器的输出目标, 返回 false 表示写出失败.
+typedef std::function<bool(const char *data, size_t len)> XWriteSink;
+
+///@brief 只能向前写的 xml 写出器, 不构建任何节点.
+/// 输出先在固定大小的缓冲区中累积, 写满后交给文件描述符或回调,
+/// 因此内存占用与输出的大小无关. 文本与属性值在写入缓冲区时批量转义,
+/// 已经转义好的内容可以通过 raw() 原样写出.
+///
+/// 写出器检查标签是否配对: 没有打开的元素时 endElement() 失败,
+/// finish() 时仍有未结束的元素也会失败. 任何一次失败之后, 后续的调用
+/// 都不再输出并返回 false, 原因可以通过 error()/errorText() 获得.
+class XWriter {
+public:
+  ///@brief 写入文件描述符, 写出器不负责关闭它.
+  explicit XWriter(int fd, size_t bufSize = XDOC_WRITER_BUFFER);
+  explicit XWriter(const XWriteSink& sink, size_t bufSize = XDOC_WRITER_BUFFER);
+  ///@brief 写出缓冲区中剩余的内容, 不检查结果, 需要检查时请调用 finish().
+  ~XWriter();
+
+  XWriter(const XWriter&) = delete;
+  XWriter& operator = (const XWriter&) = delete;
+
+  ///@brief 写出文档头, 只能在写出任何其他内容之前调用.
+  bool declaration(const char *encoding = "UTF-8",
+                   const char *standalone = nullptr);
+
+  bool startElement(const char *name, size_t len);
+  bool startElement(const std::string& name);
+  ///@brief 为刚开始的元素添加属性, 必须紧跟在 startElement() 或
+  /// 其他 attribute() 之后.
+  bool attribute(const char *key, size_t klen, const char *val, size_t vlen);
+  bool attribute(const std::string& key, const std::string& val);
+  bool text(const char *txt, size_t len);
+  bool text(const std::string& txt);
+  ///@brief 原样写出已经转义的内容, 写出器不做任何检查.
+  bool raw(const char *data, size_t len);
+  ///@brief 转义后写出, 与 raw() 一样不检查所处的位置. 已有的实体与
+  /// 字符引用保持不变, 用于写出 XDocument 中未展开引用的文本.
+  /// attr 为 true 时按属性值转义, 值需要由调用方以双引号括起.
+  bool escaped(const char *data, size_t len, bool attr);
+  ///@brief 写出注释, 内容中不能包含 "--".
+  bool comment(const char *txt, size_t len);
+  bool comment(const std::string& txt);
+  ///@brief 结束最近开始的元素, 没有子节点时写出为 <name/>.
+  bool endElement();
+
+  ///@brief 检查所有元素都已结束并写出缓冲区中剩余的内容.
+  bool finish();
+
+  ///@brief 当前打开的元素数.
+  size_t depth() const { return starts_.size(); }
+
+  XError      error();
+  std::string errorText();
+
+private:
+  bool fail(XError err, const char *txt);
+  bool closeTag();
+  bool put(const char *data, size_t len);
+  bool escape(const char *data, size_t len, bool attr, bool keepRefs = false);
+  bool flush();
+  bool emit(const char *data, size_t len);
+
+  int        fd_;
+  XWriteSink sink_;
+
+  char  *buf_;
+  size_t cap_;
+  size_t len_;
+
+  // 打开的元素名依次存放在 names_ 中, starts_ 记录各自的起始位置.
+  std::string         names_;
+  std::vector<size_t> starts_;
+
+  bool   tagOpen_; // 开始标签尚未写出 '>'.
+  bool   written_; // 已经写出过内容.
+  bool   rootDone_;
+
+  XError      error_;
+  std::string errtxt_;
+};
+
+#endif //LIBXDOC_WRITER_H